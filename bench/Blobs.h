@@ -0,0 +1,50 @@
+// seeded synthetic data for the benchmarks: points around k gaussian blobs.
+// the same spec always gives the same rows, whichever part of them is built.
+
+#ifndef BLOBS_H
+#define BLOBS_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../src/Dataset.h"
+
+struct Blobs {
+    size_t rows = 100000;
+    size_t dimensions = 13;
+    size_t k = 35;
+    // blob b is picked with weight 1 / (b + 1)^skew. 0 gives blobs of equal size
+    double skew = 0.0;
+    double spread = 0.05;               // standard deviation around every blob mean
+    unsigned seed = 42;
+
+    // rows [first, last) of the dataset, means uniform in [0, 1]^dimensions
+    [[nodiscard]] Dataset generate(size_t first = 0, size_t last = std::numeric_limits<size_t>::max()) const {
+        last = std::min(last, rows);
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::normal_distribution<double> noise(0.0, spread);
+
+        std::vector<double> means(k * dimensions);
+        for ( auto& v : means ) v = uniform(gen);
+
+        std::vector<double> weights(k);
+        for ( size_t b = 0; b < k; ++b ) weights[b] = 1.0 / std::pow(static_cast<double>(b + 1), skew);
+        std::uniform_int_distribution<size_t> even(0, k - 1);
+        std::discrete_distribution<size_t> skewed(weights.begin(), weights.end());
+
+        Dataset points(last - first, dimensions);
+        std::vector<double> row(dimensions);
+        for ( size_t i = 0; i < last; ++i ) {
+            const size_t blob = skew == 0.0 ? even(gen) : skewed(gen);
+            for ( size_t j = 0; j < dimensions; ++j ) row[j] = means[blob * dimensions + j] + noise(gen);
+            if ( i >= first ) std::ranges::copy(row, points.row(i - first).begin());
+        }
+        return points;
+    }
+};
+
+#endif // BLOBS_H
@@ -0,0 +1,89 @@
+// microbenchmark for the assignment distance kernels.
+// scores every point against every center and reports ns per distance
+// for the old pow/sqrt loop and for each instruction set the cpu supports,
+// generic and, where the width has one, fixed dimension kernels.
+
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/Distance.h"
+
+namespace {
+
+// the scalar loop Kmeans used before the kernels existed
+double legacyDistance(const double* a, const double* b, const size_t d) {
+    double sum = .0;
+    for ( size_t i = 0; i < d; ++i) sum += std::pow(a[i] - b[i], 2);
+    return std::sqrt(sum);
+}
+
+template<class F>
+double nsPerDistance(F&& assign, const size_t distances, const int repeats) {
+    assign();   // warm up
+    const auto start = std::chrono::steady_clock::now();
+    for ( int r = 0; r < repeats; ++r ) assign();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(distances * repeats);
+}
+
+void run(const size_t d, const size_t n, const size_t k) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<double> points(n * d), centers(k * d);
+    for ( auto& v : points ) v = dist(gen);
+    for ( auto& v : centers ) v = dist(gen);
+
+    std::vector<size_t> labels(n);
+    const int repeats = 3;
+    volatile size_t sink = 0;
+
+    const double legacy = nsPerDistance([&] {
+        for ( size_t i = 0; i < n; ++i ) {
+            size_t best = 0;
+            double min = legacyDistance(&points[i * d], &centers[0], d);
+            for ( size_t c = 1; c < k; ++c ) {
+                if ( const double s = legacyDistance(&points[i * d], &centers[c * d], d); s < min ) { min = s; best = c; }
+            }
+            labels[i] = best;
+        }
+        sink = labels[0];
+    }, n * k, repeats);
+    std::cout << std::format("d={:4} k={:3} {:>8}: {:7.2f} ns/distance\n", d, k, "legacy", legacy);
+
+    for ( const auto isa : {Distance::Isa::Scalar, Distance::Isa::SSE2, Distance::Isa::AVX2, Distance::Isa::AVX512} ) {
+        if ( !Distance::supported(isa) ) continue;
+        Distance::setIsa(isa);
+
+        const double ns = nsPerDistance([&] {
+            for ( size_t i = 0; i < n; ++i ) labels[i] = Distance::argmin(&points[i * d], centers.data(), k, d);
+            sink = labels[0];
+        }, n * k, repeats);
+        std::cout << std::format("d={:4} k={:3} {:>8}: {:7.2f} ns/distance ({:.1f}x)\n", d, k, Distance::name(isa), ns, legacy / ns);
+
+        // kernels compiled for exactly d dimensions, when d has them
+        const auto kernels = Distance::kernels<double>(d);
+        if ( !kernels.fixed() ) continue;
+        const double fixed = nsPerDistance([&] {
+            for ( size_t i = 0; i < n; ++i ) labels[i] = kernels.argmin(&points[i * d], centers.data(), k);
+            sink = labels[0];
+        }, n * k, repeats);
+        std::cout << std::format("d={:4} k={:3} {:>8}: {:7.2f} ns/distance ({:.1f}x, fixed d)\n", d, k, Distance::name(isa), fixed, legacy / fixed);
+    }
+    (void)sink;
+}
+
+} // namespace
+
+int main() {
+    constexpr size_t k = 35;
+
+    run(13, 200000, k);     // spotify feature width
+    run(128, 20000, k);
+    run(768, 4000, k);
+
+    return 0;
+}
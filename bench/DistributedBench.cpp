@@ -0,0 +1,103 @@
+// distributed fit with several local processes over SocketTransport.
+// every rank builds the same synthetic blobs and keeps one contiguous shard.
+// rank 0 also fits the whole dataset in one process and reports the time of
+// both fits and the mean squared distance of all points to either set of centers.
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/Distance.h"
+#include "../src/Kmeans.h"
+#include "../src/SocketTransport.h"
+#include "Blobs.h"
+
+namespace {
+
+constexpr size_t ROWS = 400000;
+constexpr size_t DIMENSIONS = 13;
+constexpr int K = 35;
+
+// rows [first, last) of the blobs every rank builds
+Dataset blobs(const size_t first, const size_t last) {
+    return Blobs{.rows = ROWS, .dimensions = DIMENSIONS, .k = K}.generate(first, last);
+}
+
+// mean squared distance of every point to its closest center
+double inertia(const Dataset& points, const std::vector<Point>& centers) {
+    std::vector<double> flat;
+    for ( const auto& center : centers ) flat.insert(flat.end(), center.cords().begin(), center.cords().end());
+
+    double sum = 0.0;
+    for ( size_t i = 0; i < points.rows(); ++i ) {
+        double best;
+        static_cast<void>(Distance::argmin(points.row(i).data(), flat.data(), centers.size(), points.dimensions(), &best));
+        sum += best;
+    }
+    return sum / static_cast<double>(points.rows());
+}
+
+double millisSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int runRank(const std::string& path, const size_t rank, const size_t ranks, const size_t threads) {
+    ThreadPool pool(threads);
+    Dataset shard = blobs(ROWS * rank / ranks, ROWS * (rank + 1) / ranks);
+
+    KmeansConfig config;
+    config.seed = 7;
+    config.assignment = Assignment::Hamerly;
+
+    SocketTransport transport(path, rank, ranks);
+    Kmeans distributed(K, DIMENSIONS, 100, config);
+    const auto start = std::chrono::steady_clock::now();
+    distributed.fit(shard, pool, transport);
+    const double distributed_ms = millisSince(start);
+    if ( rank != 0 ) return 0;
+
+    //-- the same fit in one process. it seeds from all rows, not from shard 0,
+    //-- so the centers differ a little and only the inertia is compared
+    Dataset all = blobs(0, ROWS);
+    LocalTransport local;
+    Kmeans single(K, DIMENSIONS, 100, config);
+    const auto reference_start = std::chrono::steady_clock::now();
+    single.fit(all, pool, local);
+    const double single_ms = millisSince(reference_start);
+
+    const double distributed_inertia = inertia(all, distributed.centers());
+    const double single_inertia = inertia(all, single.centers());
+
+    std::cout << std::format("ranks={} threads/rank={} rows={} distributed: {:.1f} ms {} it  single: {:.1f} ms {} it"
+                             "  inertia: {:.6f} vs {:.6f}\n",
+                             ranks, threads, ROWS, distributed_ms, distributed.prunedDistances().size(),
+                             single_ms, single.prunedDistances().size(), distributed_inertia, single_inertia);
+    return 0;
+}
+
+} // namespace
+
+int main() {
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+
+    for ( const size_t ranks : {size_t{1}, size_t{2}, size_t{4}} ) {
+        const std::string path = std::format("/tmp/kmeans-bench-{}.sock", ::getpid());
+        const size_t threads = std::max<size_t>(1, hardware / ranks);
+
+        std::vector<pid_t> children;
+        for ( size_t rank = 1; rank < ranks; ++rank ) {
+            const pid_t child = ::fork();
+            if ( child == 0 ) _exit(runRank(path, rank, ranks, threads));
+            children.push_back(child);
+        }
+        runRank(path, 0, ranks, threads);
+        for ( const pid_t child : children ) ::waitpid(child, nullptr, 0);
+    }
+
+    return 0;
+}
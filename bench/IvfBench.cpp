@@ -0,0 +1,58 @@
+// approximate assignment with an inverted file over the centers against the
+// exact scan, on synthetic blobs with large k. every fit starts from the same
+// seed; for a growing number of probes reports the time, the share of distance
+// computations skipped, the inertia and how many labels match the exact closest center.
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "../src/Kmeans.h"
+#include "Blobs.h"
+
+namespace {
+
+void fit(const Dataset& source, const size_t k, const Assignment assignment, const size_t probes, ThreadPool& pool) {
+    Dataset points = source;
+    KmeansConfig config;
+    config.seed = 7;
+    config.assignment = assignment;
+    config.initialization = Initialization::Random;
+    config.ivf_probes = probes;
+    config.verbose = false;
+    Kmeans model(static_cast<int>(k), static_cast<int>(source.dimensions()), 10, config);
+
+    const auto start = std::chrono::steady_clock::now();
+    model.fit(points, pool);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto& skipped = model.prunedDistances();
+    const double total = static_cast<double>(skipped.size() * points.rows() * k);
+    const double skipped_share = std::accumulate(skipped.begin(), skipped.end(), 0.0) / total;
+
+    const std::string name = assignment == Assignment::Ivf ? std::format("ivf/{}", probes) : "direct";
+    std::cout << std::format("n={} d={} k={} {:10} {:9.1f} ms {:3} it  skipped: {:6.2f}%  inertia: {:.6f}  agreement: {:6.2f}%\n",
+                             points.rows(), points.dimensions(), k, name, elapsed.count(), skipped.size(),
+                             100.0 * skipped_share, model.inertia(points, pool) / static_cast<double>(points.rows()),
+                             100.0 * model.agreement(points, pool));
+}
+
+void run(const size_t n, const size_t d, const size_t k, ThreadPool& pool) {
+    const Dataset points = Blobs{.rows = n, .dimensions = d, .k = k}.generate();
+    fit(points, k, Assignment::Direct, 0, pool);
+    for ( const size_t probes : {1, 2, 4, 8, 16} ) fit(points, k, Assignment::Ivf, probes, pool);
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+
+    run(100000, 16, 2048, pool);
+    run(50000, 64, 4096, pool);
+
+    return 0;
+}
@@ -0,0 +1,311 @@
+// benchmark suite on seeded synthetic blobs, results as json on stdout.
+// microbenchmarks for the distance kernels, one assignment pass, the center
+// update, csv loading, result grouping and label output and pool dispatch,
+// then end to end fits with every assignment engine. progress goes to stderr,
+// so stdout can be saved and compared between versions.
+//
+// usage: kmeans_bench [rows=N] [dimensions=D] [k=K] [skew=S] [threads=T] [iterations=I] [repeats=R] [seed=S]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "../src/CsvReader.h"
+#include "../src/Distance.h"
+#include "../src/GemmAssigner.h"
+#include "../src/Kmeans.h"
+#include "../src/Utils.h"
+#include "Blobs.h"
+
+namespace {
+
+struct Options {
+    Blobs data;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    int iterations = 50;
+    int repeats = 3;
+};
+
+// one result: what ran and what it measured
+struct Record {
+    std::string group;
+    std::string name;
+    std::vector<std::pair<std::string, double>> values;
+};
+
+Options parse(const int argc, char** argv) {
+    Options options;
+    for ( int i = 1; i < argc; ++i ) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        if ( eq == std::string::npos ) throw std::invalid_argument(std::format("[ERROR] Expected key=value, got: {}", arg));
+        const std::string key = arg.substr(0, eq);
+        const std::string value = arg.substr(eq + 1);
+
+        if ( key == "rows" ) options.data.rows = std::stoul(value);
+        else if ( key == "dimensions" ) options.data.dimensions = std::stoul(value);
+        else if ( key == "k" ) options.data.k = std::stoul(value);
+        else if ( key == "skew" ) options.data.skew = std::stod(value);
+        else if ( key == "seed" ) options.data.seed = static_cast<unsigned>(std::stoul(value));
+        else if ( key == "threads" ) options.threads = std::stoul(value);
+        else if ( key == "iterations" ) options.iterations = std::stoi(value);
+        else if ( key == "repeats" ) options.repeats = std::max(1, std::stoi(value));
+        else throw std::invalid_argument(std::format("[ERROR] Unknown option: {}", key));
+    }
+    return options;
+}
+
+// median wall time of `repeats` runs after one warm up, in nanoseconds
+template<class F>
+double medianNs(F&& body, const int repeats) {
+    body();
+    std::vector<double> samples;
+    for ( int r = 0; r < repeats; ++r ) {
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::ranges::nth_element(samples, samples.begin() + static_cast<std::ptrdiff_t>(samples.size() / 2));
+    return samples[samples.size() / 2];
+}
+
+// the first k rows as centers, like random seeding would pick them
+template<typename T, typename S>
+AlignedVector<T> firstRows(const BasicDataset<S>& points, const size_t k) {
+    AlignedVector<T> centers(k * points.dimensions());
+    const auto values = points.values();
+    for ( size_t i = 0; i < centers.size(); ++i ) centers[i] = static_cast<T>(values[i]);
+    return centers;
+}
+
+//-- microbenchmarks
+
+template<typename T>
+Record distance(const BasicDataset<T>& points, const size_t k, const int repeats) {
+    const auto kernels = Distance::kernels<T>(points.dimensions());
+    const auto centers = firstRows<T>(points, k);
+    const size_t sample = std::min<size_t>(points.rows(), 4096);
+    std::vector<T> out(k);
+    volatile T sink = 0;
+
+    const double ns = medianNs([&] {
+        for ( size_t i = 0; i < sample; ++i ) {
+            kernels.squaredL2Block(points.row(i).data(), centers.data(), k, out.data());
+            sink = out[0];
+        }
+    }, repeats);
+    return {"distance", std::is_same_v<T, float> ? "float" : "double",
+            {{"ns_per_distance", ns / static_cast<double>(sample * k)}, {"fixed_kernel", kernels.fixed() ? 1.0 : 0.0}}};
+}
+
+std::vector<Record> assignment(const Dataset& points, const size_t k, ThreadPool& pool, const int repeats) {
+    const size_t rows = points.rows();
+    const size_t d = points.dimensions();
+    const auto kernels = Distance::kernels<double>(d);
+    const auto centers = firstRows<double>(points, k);
+    const size_t grain = std::max<size_t>(256, rows / (pool.numThreads() * Kmeans::CHUNKS_PER_THREAD));
+    std::vector<int> labels(rows, -1);
+
+    const double direct = medianNs([&] {
+        pool.parallelFor(0, rows, grain, [&](const size_t start, const size_t end) {
+            for ( size_t i = start; i < end; ++i ) {
+                labels[i] = static_cast<int>(kernels.argmin(points.row(i).data(), centers.data(), k));
+            }
+        });
+    }, repeats);
+
+    GemmAssigner<double> gemm(k, d);
+    gemm.setCenters(centers.data());
+    const double tiled = medianNs([&] {
+        pool.parallelFor(0, rows, grain, [&](const size_t start, const size_t end) {
+            static_cast<void>(gemm.assign(points.row(start).data(), end - start, labels.data() + start));
+        });
+    }, repeats);
+
+    const auto record = [rows](const char* name, const double ns) {
+        return Record{"assignment", name, {{"ms", ns / 1e6}, {"points_per_sec", static_cast<double>(rows) / ns * 1e9}}};
+    };
+    return {record("direct", direct), record("gemm", tiled)};
+}
+
+Record update(const Dataset& points, const size_t k, const int repeats) {
+    // sums and counts of every cluster, then the means, like one center update
+    const size_t rows = points.rows();
+    const size_t d = points.dimensions();
+    const auto kernels = Distance::kernels<double>(d);
+    std::vector<double> sums(k * d);
+    std::vector<size_t> counts(k);
+    std::vector<double> means(k * d);
+
+    const double ns = medianNs([&] {
+        std::ranges::fill(sums, 0.0);
+        std::ranges::fill(counts, 0);
+        for ( size_t i = 0; i < rows; ++i ) {
+            const size_t cluster = i % k;
+            kernels.accumulate(points.row(i).data(), sums.data() + cluster * d);
+            counts[cluster]++;
+        }
+        for ( size_t c = 0; c < k; ++c ) {
+            for ( size_t j = 0; j < d; ++j ) means[c * d + j] = sums[c * d + j] / static_cast<double>(counts[c]);
+        }
+    }, repeats);
+    return {"update", "accumulate_and_mean", {{"ns_per_point", ns / static_cast<double>(rows)}}};
+}
+
+Record csvLoad(const Dataset& points, ThreadPool& pool, const int repeats) {
+    const auto path = std::filesystem::temp_directory_path() / std::format("kmeans-bench-{}.csv", ::getpid());
+    {
+        std::ofstream out(path);
+        for ( size_t j = 0; j < points.dimensions(); ++j ) out << (j ? "," : "") << "f" << j;
+        out << '\n';
+        for ( size_t i = 0; i < points.rows(); ++i ) {
+            const auto row = points.row(i);
+            for ( size_t j = 0; j < row.size(); ++j ) out << (j ? "," : "") << std::format("{:.6f}", row[j]);
+            out << '\n';
+        }
+    }
+    const double bytes = static_cast<double>(std::filesystem::file_size(path));
+
+    size_t rows = 0;
+    const double ns = medianNs([&] { rows = CsvReader::read(path.string(), pool, {}).rows(); }, repeats);
+    std::filesystem::remove(path);
+    if ( rows != points.rows() ) throw std::runtime_error("[ERROR] The benchmark csv was not read back whole.");
+
+    return {"csv_load", "read", {{"ms", ns / 1e6}, {"rows_per_sec", static_cast<double>(rows) / ns * 1e9},
+                                 {"mb_per_sec", bytes / ns * 1e3}}};
+}
+
+std::vector<Record> output(const Dataset& points, const size_t k, ThreadPool& pool, const int repeats) {
+    const size_t rows = points.rows();
+    std::vector<int> labels(rows);
+    for ( size_t i = 0; i < rows; ++i ) labels[i] = static_cast<int>(i * 2654435761u % k);
+
+    size_t grouped = 0;
+    const double group_ns = medianNs([&] { grouped = Utils::groupByClusters(labels, pool).rows.size(); }, repeats);
+    if ( grouped != rows ) throw std::runtime_error("[ERROR] The benchmark labels were not grouped whole.");
+
+    const auto path = std::filesystem::temp_directory_path() / std::format("kmeans-bench-{}.labels", ::getpid());
+    const double csv_ns = medianNs([&] { Utils::writeLabels(labels, path.string(), LabelFormat::Csv, pool); }, repeats);
+    const double bytes = static_cast<double>(std::filesystem::file_size(path));
+    std::filesystem::remove(path);
+
+    return {{"output", "group_by_clusters", {{"ns_per_row", group_ns / static_cast<double>(rows)}}},
+            {"output", "labels_csv", {{"ms", csv_ns / 1e6}, {"mb_per_sec", bytes / csv_ns * 1e3}}}};
+}
+
+std::vector<Record> dispatch(ThreadPool& pool, const size_t rows, const int repeats) {
+    constexpr size_t tasks = 20000;
+    std::atomic<size_t> total = 0;
+    const double per_task = medianNs([&] {
+        pool.parallelFor(0, tasks, 1, [&total](size_t, size_t) { total.fetch_add(1, std::memory_order_relaxed); });
+    }, repeats);
+
+    // one split/join pass over the rows, as Kmeans runs every iteration
+    const std::vector<double> values(rows, 1.0);
+    const size_t grain = std::max<size_t>(256, rows / (pool.numThreads() * Kmeans::CHUNKS_PER_THREAD));
+    volatile double sink = 0.0;
+    const double per_loop = medianNs([&] {
+        sink = pool.parallelReduce(size_t{0}, rows, grain, 0.0, [&values](const size_t b, const size_t e) {
+            double sum = 0.0;
+            for ( size_t i = b; i < e; ++i ) sum += values[i];
+            return sum;
+        }, std::plus<>());
+    }, repeats);
+
+    return {{"dispatch", "empty_task", {{"ns_per_task", per_task / tasks}}},
+            {"dispatch", "reduce_pass", {{"us", per_loop / 1e3}}}};
+}
+
+//-- end to end
+
+Record fit(const Dataset& source, const size_t k, const char* name, const KmeansConfig& config, const int iterations,
+           ThreadPool& pool) {
+    Dataset points = source;
+    Kmeans model(static_cast<int>(k), static_cast<int>(source.dimensions()), iterations, config);
+
+    const auto start = std::chrono::steady_clock::now();
+    model.fit(points, pool);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // mini-batch steps visit one batch each, then every row once for the final labels
+    const double rows = static_cast<double>(points.rows());
+    const double taken = static_cast<double>(model.iterations());
+    const double visited = config.mode == Mode::MiniBatch
+        ? taken * static_cast<double>(std::min(std::max<size_t>(1, config.batch_size), points.rows())) + rows
+        : taken * rows;
+    return {"fit", name, {{"ms", ns / 1e6}, {"iterations", taken},
+                          {"points_per_sec", visited / ns * 1e9},
+                          {"inertia", model.inertia(points, pool) / rows}, {"agreement", model.agreement(points, pool)}}};
+}
+
+void print(const Options& options, const std::vector<Record>& records) {
+    const Blobs& data = options.data;
+    std::cout << "{\n  \"config\": {";
+    std::cout << std::format("\"rows\": {}, \"dimensions\": {}, \"k\": {}, \"skew\": {}, \"spread\": {}, \"seed\": {}, "
+                             "\"threads\": {}, \"iterations\": {}, \"repeats\": {}",
+                             data.rows, data.dimensions, data.k, data.skew, data.spread, data.seed,
+                             options.threads, options.iterations, options.repeats);
+    std::cout << "},\n  \"results\": [\n";
+    for ( size_t r = 0; r < records.size(); ++r ) {
+        std::cout << std::format("    {{\"group\": \"{}\", \"name\": \"{}\"", records[r].group, records[r].name);
+        for ( const auto& [key, value] : records[r].values ) std::cout << std::format(", \"{}\": {}", key, value);
+        std::cout << (r + 1 < records.size() ? "},\n" : "}\n");
+    }
+    std::cout << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(const int argc, char** argv) {
+    const Options options = parse(argc, argv);
+    const size_t k = options.data.k;
+    if ( k == 0 || k > options.data.rows ) throw std::invalid_argument("[ERROR] Need 0 < k <= rows.");
+
+    ThreadPool pool(options.threads);
+    const Dataset points = options.data.generate();
+    std::vector<Record> records;
+    const auto add = [&records](Record record) {
+        std::cerr << std::format("{:10} {}\n", record.group, record.name);
+        records.push_back(std::move(record));
+    };
+    const auto addAll = [&add](std::vector<Record> batch) { for ( auto& record : batch ) add(std::move(record)); };
+
+    add(distance(points, k, options.repeats));
+    add(distance(BasicDataset<float>(points), k, options.repeats));
+    addAll(assignment(points, k, pool, options.repeats));
+    add(update(points, k, options.repeats));
+    add(csvLoad(points, pool, options.repeats));
+    addAll(output(points, k, pool, options.repeats));
+    addAll(dispatch(pool, points.rows(), options.repeats));
+
+    const std::pair<const char*, Assignment> engines[] = {
+        {"direct", Assignment::Direct}, {"gemm", Assignment::Gemm}, {"hamerly", Assignment::Hamerly},
+        {"elkan", Assignment::Elkan}, {"ivf", Assignment::Ivf},
+    };
+    for ( const auto& [name, engine] : engines ) {
+        KmeansConfig config;
+        config.seed = options.data.seed;
+        config.assignment = engine;
+        config.verbose = false;
+        add(fit(points, k, name, config, options.iterations, pool));
+    }
+    KmeansConfig mini_batch;
+    mini_batch.seed = options.data.seed;
+    mini_batch.mode = Mode::MiniBatch;
+    mini_batch.verbose = false;
+    add(fit(points, k, "mini_batch", mini_batch, options.iterations, pool));
+
+    print(options, records);
+    return 0;
+}
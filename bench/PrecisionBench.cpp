@@ -0,0 +1,88 @@
+// float against double k-means on the same synthetic blobs.
+// both fits start from the same seed; for every assignment engine reports the
+// time, the iterations and how far the float inertia and labels are from double.
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/Distance.h"
+#include "../src/Kmeans.h"
+#include "Blobs.h"
+
+namespace {
+
+// mean squared distance of every point to its center, always in double
+double inertia(const Dataset& points, const std::span<const int> labels, const std::vector<Point>& centers) {
+    double sum = 0.0;
+    for ( size_t i = 0; i < points.rows(); ++i ) {
+        sum += Distance::squaredL2(points.row(i), std::span<const double>(centers[labels[i]].cords()));
+    }
+    return sum / static_cast<double>(points.rows());
+}
+
+struct Run {
+    double ms;
+    size_t iterations;
+    double inertia;
+    std::vector<int> labels;
+};
+
+template<typename T>
+Run fit(const Dataset& source, const size_t k, const KmeansConfig& config, ThreadPool& pool) {
+    BasicDataset<T> points(source);
+    BasicKmeans<T> model(static_cast<int>(k), static_cast<int>(source.dimensions()), 100, config);
+
+    const auto start = std::chrono::steady_clock::now();
+    model.fit(points, pool);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<int> labels(points.labels().begin(), points.labels().end());
+    const double score = inertia(source, labels, model.centers());
+    return {elapsed.count(), model.prunedDistances().size(), score, std::move(labels)};
+}
+
+const char* name(const Assignment assignment) {
+    switch ( assignment ) {
+        case Assignment::Direct: return "direct";
+        case Assignment::Gemm: return "gemm";
+        case Assignment::Hamerly: return "hamerly";
+        case Assignment::Elkan: return "elkan";
+        default: return "auto";
+    }
+}
+
+void run(const size_t n, const size_t d, const size_t k, ThreadPool& pool) {
+    const Dataset points = Blobs{.rows = n, .dimensions = d, .k = k}.generate();
+
+    for ( const auto assignment : {Assignment::Direct, Assignment::Gemm, Assignment::Hamerly, Assignment::Elkan} ) {
+        KmeansConfig config;
+        config.seed = 7;
+        config.assignment = assignment;
+
+        const Run wide = fit<double>(points, k, config, pool);
+        const Run narrow = fit<float>(points, k, config, pool);
+
+        size_t agree = 0;
+        for ( size_t i = 0; i < n; ++i ) agree += wide.labels[i] == narrow.labels[i];
+
+        std::cout << std::format("n={:7} d={:3} k={:3} {:8} double: {:9.1f} ms {:3} it  float: {:9.1f} ms {:3} it ({:.2f}x)"
+                                 "  inertia diff: {:+.2e}  labels agree: {:6.2f}%\n",
+                                 n, d, k, name(assignment), wide.ms, wide.iterations, narrow.ms, narrow.iterations,
+                                 wide.ms / narrow.ms, (narrow.inertia - wide.inertia) / wide.inertia,
+                                 100.0 * static_cast<double>(agree) / static_cast<double>(n));
+    }
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+
+    run(200000, 13, 35, pool);
+    run(100000, 64, 100, pool);
+
+    return 0;
+}
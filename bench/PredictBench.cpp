@@ -0,0 +1,102 @@
+// latency of labelling new points with a fitted model.
+// single point predict from several threads at once, then batches of growing
+// size on the calling thread and over the pool. reports p50 and p99 per call
+// and the batch throughput, for a small and a large k * d model.
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/Kmeans.h"
+#include "Blobs.h"
+
+namespace {
+
+constexpr size_t QUERIES = 20000;
+
+// microseconds at quantile q of the sorted samples
+double quantile(std::vector<double>& samples, const double q) {
+    const size_t index = std::min(samples.size() - 1, static_cast<size_t>(q * static_cast<double>(samples.size())));
+    std::ranges::nth_element(samples, samples.begin() + static_cast<std::ptrdiff_t>(index));
+    return samples[index];
+}
+
+template<typename F>
+double microsOf(F&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void run(const size_t d, const size_t k, const Assignment assignment, ThreadPool& pool) {
+    Dataset train = Blobs{.rows = 100000, .dimensions = d, .k = k}.generate();
+    const Dataset queries = Blobs{.rows = QUERIES, .dimensions = d, .k = k, .seed = 43}.generate();
+
+    KmeansConfig config;
+    config.seed = 7;
+    config.assignment = assignment;
+    config.verbose = false;
+    Kmeans model(static_cast<int>(k), static_cast<int>(d), 20, config);
+    model.fit(train, pool);
+
+    //-- one point per call, every thread with its own share of the queries
+    const size_t callers = std::max<size_t>(1, std::min<size_t>(4, std::thread::hardware_concurrency()));
+    std::vector<std::vector<double>> per_caller(callers);
+    std::vector<std::thread> threads;
+    for ( size_t t = 0; t < callers; ++t ) {
+        threads.emplace_back([&, t] {
+            auto& samples = per_caller[t];
+            for ( size_t i = t; i < QUERIES; i += callers ) {
+                int label = 0;
+                samples.push_back(microsOf([&] { label = model.predict(queries.row(i)); }));
+                if ( label < 0 ) std::cerr << "unreachable\n";
+            }
+        });
+    }
+    for ( auto& thread : threads ) thread.join();
+
+    std::vector<double> single;
+    for ( const auto& samples : per_caller ) single.insert(single.end(), samples.begin(), samples.end());
+    std::cout << std::format("d={:3} k={:4} {:6} predict x{} threads  p50: {:7.2f} us  p99: {:7.2f} us\n",
+                             d, k, assignment == Assignment::Gemm ? "gemm" : "direct", callers,
+                             quantile(single, 0.5), quantile(single, 0.99));
+
+    //-- batches
+    std::vector<int> labels(QUERIES);
+    std::vector<double> distances(QUERIES);
+    for ( const size_t batch : {size_t{16}, size_t{256}, size_t{4096}, QUERIES} ) {
+        for ( const bool parallel : {false, true} ) {
+            std::vector<double> samples;
+            for ( int repeat = 0; repeat < 5; ++repeat ) {
+                for ( size_t first = 0; first + batch <= QUERIES; first += batch ) {
+                    const std::span<const double> rows(queries.row(first).data(), batch * d);
+                    const std::span<int> out(labels.data() + first, batch);
+                    const std::span<double> out_distances(distances.data() + first, batch);
+                    samples.push_back(microsOf([&] {
+                        if ( parallel ) model.predictBatch(rows, out, pool, out_distances);
+                        else model.predictBatch(rows, out, out_distances);
+                    }));
+                }
+            }
+            const double p50 = quantile(samples, 0.5);
+            std::cout << std::format("    batch {:6} {:6}  p50: {:9.2f} us  p99: {:9.2f} us  {:7.2f} M rows/s\n",
+                                     batch, parallel ? "pool" : "caller", p50, quantile(samples, 0.99),
+                                     static_cast<double>(batch) / p50);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+
+    run(13, 35, Assignment::Direct, pool);
+    run(64, 256, Assignment::Direct, pool);
+    run(64, 256, Assignment::Gemm, pool);
+
+    return 0;
+}
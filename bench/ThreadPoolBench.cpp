@@ -0,0 +1,158 @@
+// microbenchmark for task dispatch.
+// compares the old single queue pool (std::bind + packaged_task + future per
+// task) with the work-stealing pool, for lone tasks and for the split/join
+// loops Kmeans runs every iteration.
+
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "../src/ThreadPool.h"
+
+namespace {
+
+// the pool before work stealing: one queue behind one mutex
+class LegacyPool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> taskQueue;
+    std::mutex queueMutex;
+    std::condition_variable cv;
+    bool stop = false;
+
+public:
+    explicit LegacyPool(const size_t numThreads) {
+        for ( size_t i = 0; i < numThreads; ++i ) {
+            workers.emplace_back([this] {
+                while ( true ) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queueMutex);
+                        cv.wait(lock, [this] { return stop || !taskQueue.empty(); });
+                        if ( stop && taskQueue.empty() ) return;
+                        task = std::move(taskQueue.front());
+                        taskQueue.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~LegacyPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for ( auto& worker : workers ) worker.join();
+    }
+
+    template<typename F, typename... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>> {
+        using return_type = std::invoke_result_t<F, Args...>;
+        auto task = std::make_shared<std::packaged_task<return_type()>>(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> res = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            taskQueue.push([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return res;
+    }
+};
+
+template<class F>
+double nsPer(F&& body, const size_t operations, const int repeats) {
+    body();     // warm up
+    const auto start = std::chrono::steady_clock::now();
+    for ( int r = 0; r < repeats; ++r ) body();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(operations * repeats);
+}
+
+// sums [begin, end) of `values`, the work of one chunk
+double sumRange(const std::vector<double>& values, const size_t begin, const size_t end) {
+    double sum = 0.0;
+    for ( size_t i = begin; i < end; ++i ) sum += values[i];
+    return sum;
+}
+
+void run(const size_t threads) {
+    LegacyPool legacy(threads);
+    ThreadPool pool(threads);
+    volatile double sink = 0.0;
+
+    //-- lone tasks: submit many empty tasks, wait for all of them
+    constexpr size_t tasks = 20000;
+    const double legacy_task = nsPer([&] {
+        std::vector<std::future<int>> futures;
+        futures.reserve(tasks);
+        for ( size_t t = 0; t < tasks; ++t ) futures.push_back(legacy.enqueue([] { return 1; }));
+        int total = 0;
+        for ( auto& future : futures ) total += future.get();
+        sink = total;
+    }, tasks, 5);
+    const double enqueue_task = nsPer([&] {
+        std::vector<std::future<int>> futures;
+        futures.reserve(tasks);
+        for ( size_t t = 0; t < tasks; ++t ) futures.push_back(pool.enqueue([] { return 1; }));
+        int total = 0;
+        for ( auto& future : futures ) total += future.get();
+        sink = total;
+    }, tasks, 5);
+    const double for_task = nsPer([&] {
+        std::atomic<int> total = 0;
+        pool.parallelFor(0, tasks, 1, [&](size_t, size_t) { total.fetch_add(1, std::memory_order_relaxed); });
+        sink = total;
+    }, tasks, 5);
+
+    std::cout << std::format("threads={:2} empty task  legacy: {:8.1f} ns  enqueue: {:8.1f} ns  parallelFor: {:8.1f} ns\n",
+                             threads, legacy_task, enqueue_task, for_task);
+
+    //-- split/join loops like one Kmeans pass, for a few problem sizes
+    for ( const size_t rows : {size_t{1} << 12, size_t{1} << 16, size_t{1} << 20} ) {
+        const std::vector<double> values(rows, 1.0);
+        const size_t chunk = std::max<size_t>(1, rows / threads);
+        const int repeats = static_cast<int>(std::max<size_t>(20, (size_t{1} << 24) / rows));
+
+        const double old_loop = nsPer([&] {
+            std::vector<std::future<double>> futures;
+            for ( size_t start = 0; start < rows; start += chunk ) {
+                futures.push_back(legacy.enqueue([&values, start, chunk, rows] {
+                    return sumRange(values, start, std::min(start + chunk, rows));
+                }));
+            }
+            double total = 0.0;
+            for ( auto& future : futures ) total += future.get();
+            sink = total;
+        }, 1, repeats);
+
+        const double new_loop = nsPer([&] {
+            sink = pool.parallelReduce(size_t{0}, rows, chunk, 0.0,
+                [&values](const size_t b, const size_t e) { return sumRange(values, b, e); }, std::plus<>());
+        }, 1, repeats);
+
+        std::cout << std::format("threads={:2} rows={:8} loop    legacy: {:8.1f} us  parallelReduce: {:8.1f} us ({:.2f}x)\n",
+                                 threads, rows, old_loop / 1e3, new_loop / 1e3, old_loop / new_loop);
+    }
+    (void)sink;
+}
+
+} // namespace
+
+int main() {
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+
+    run(1);
+    if ( hardware > 1 ) run(hardware);
+
+    return 0;
+}
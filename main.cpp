@@ -2,43 +2,50 @@
 #include <fstream>
 #include <iostream>
 #include "vector"
-#include "src/Point.h"
+#include "src/CsvReader.h"
+#include "src/Dataset.h"
+#include "src/FeatureCache.h"
 #include "src/Kmeans.h"
+#include "src/Topology.h"
 #include "src/Utils.h"
 
 #define LIMIT (-1)
 #define MAX_ITERATIONS 1000
+#define WRITE_LABELS false
+#define PIN_THREADS false     // one worker bound to every cpu, for machines the run has to itself
 // TIP To <b>Run</b> code, press <shortcut actionId="Run"/> or
 // click the <icon src="AllIcons.Actions.Execute"/> icon in the gutter.
 int main() {
-    int lines = 0;
     constexpr int k = 35; // amount of clusters in kmeans
 
-    // read from file
-    const auto data = Utils::processCsv("../data/tracks/cleaned_tracks_features.csv", lines, LIMIT);
-    std::cout << std::format("Read {} lines.\n",lines);
+    // create thread pool, one worker for every cpu this process may run on
+    const size_t allowed = Topology::detect().cpus().size();
+    const size_t num_threads = allowed > 0 ? allowed : std::thread::hardware_concurrency();
+    ThreadPool pool(num_threads, PIN_THREADS);
+    std::cout << std::format("Created ThreadPool with {} threads on {} numa nodes.\n",num_threads, pool.numNodes());
 
-    // get numeric fields
-    const std::vector<std::string> numeric_fields = Utils::findNumericFields(data.at(0));
-    const int dimensions = static_cast<int> ( numeric_fields.size() );
+    const std::vector<std::string> desired_fields = { "name", "album","artists"};
 
-    // create points representing the tracks
-    std::vector<Point> tracks;
-    Utils::pointsFromMap(tracks,data,numeric_fields);
+    // read from file. numeric columns become the normalized features of the tracks.
+    // the parsed file is cached next to it and rebuilt when the csv changes
+    const std::string source = "../data/tracks/cleaned_tracks_features.csv";
+    auto [data, scaler, rebuilt] = FeatureCache::load(source, source + ".cache", pool, desired_fields, LIMIT);
+    std::cout << std::format("Read {} lines{}.\n",data.rows(), rebuilt ? "" : " from cache");
 
-    // create thread pool
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    std::cout << std::format("Created ThreadPool with {} threads.\n",num_threads);
-    ThreadPool pool(num_threads);
+    Dataset& tracks = data.features();
+    const int dimensions = static_cast<int> ( data.numericFields().size() );
 
     // fit tracks
     std::cout << std::format("Executing k-means with {} clusters.\n",k);
-    Kmeans km(k,dimensions,MAX_ITERATIONS);
+    KmeansConfig config;
+    config.numa = pool.numNodes() > 1;     // keep every worker's rows on its own node
+    Kmeans km(k,dimensions,MAX_ITERATIONS,config);
     km.fit(tracks, pool);
 
-    const auto result = Utils::groupByClusters(tracks);
+    // tracks given to the model later have to be scaled the same way
+    scaler.save("scaler.bin");
 
-    const std::vector<std::string> desired_fields = { "name", "album","artists"};
+    const auto result = Utils::groupByClusters(tracks.labels(), pool);
 
     const auto path = "output.txt";
     std::ofstream out(path);
@@ -46,8 +53,11 @@ int main() {
         throw std::runtime_error(std::format("[ERROR] Could not create file: {}", path));
     }
 
-    Utils::toFile(result,data, out, desired_fields);
+    Utils::toFile(result,data, out, desired_fields, pool);
     out.close();
+
+    // every row's cluster, in file order
+    if ( WRITE_LABELS ) Utils::writeLabels(tracks.labels(), "labels.csv", LabelFormat::Csv, pool);
     return 0;
 }
 
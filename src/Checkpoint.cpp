@@ -0,0 +1,117 @@
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+#include "Hash.h"
+
+namespace {
+
+template<typename V>
+void writeAll(std::ostream& out, const std::vector<V>& values) {
+    out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(V)));
+}
+
+template<typename V>
+void readAll(std::istream& in, std::vector<V>& values, const size_t count) {
+    values.resize(count);
+    in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(count * sizeof(V)));
+}
+
+} // namespace
+
+void Checkpoint::save(const std::string& path) const {
+    const size_t rows = labels.size();
+    if ( centers.size() != k * dimensions || counts.size() != k || row_hashes.size() != rows ) {
+        throw std::invalid_argument("[ERROR] Checkpoint parts do not match in size.");
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.version = VERSION;
+    header.scalar_bytes = scalar_bytes;
+    header.k = k;
+    header.dimensions = dimensions;
+    header.rows = rows;
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if ( !out.is_open() ) throw std::runtime_error(std::format("[ERROR] Could not create file: {}", temporary));
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof header);
+        writeAll(out, centers);
+        writeAll(out, counts);
+        writeAll(out, labels);
+        writeAll(out, row_hashes);
+
+        if ( !out ) throw std::runtime_error(std::format("[ERROR] Could not write file: {}", temporary));
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+Checkpoint Checkpoint::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if ( !in.is_open() ) throw std::runtime_error(std::format("[ERROR] Could not open file: {}", path));
+
+    Header header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof header);
+    if ( !in || std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 ) {
+        throw std::runtime_error(std::format("[ERROR] Not a checkpoint: {}", path));
+    }
+    if ( header.version != VERSION ) {
+        throw std::runtime_error(std::format("[ERROR] Checkpoint version {} is not supported: {}", header.version, path));
+    }
+
+    // centers, counts, then labels and hashes, each checked by division so a corrupt header cannot wrap the sizes
+    const auto fits = [](const uint64_t offset, const uint64_t count, const uint64_t bytes, const uint64_t limit) {
+        return offset <= limit && count <= (limit - offset) / bytes;
+    };
+    const uint64_t size = std::filesystem::file_size(path);
+    uint64_t offset = sizeof header;
+    bool intact = fits(offset, header.k, sizeof(double), size)
+                  && (header.k == 0 || fits(offset, header.dimensions, header.k * sizeof(double), size));
+    if ( intact ) {
+        offset += header.k * header.dimensions * sizeof(double);
+        intact = fits(offset, header.k, sizeof(uint64_t), size);
+    }
+    if ( intact ) {
+        offset += header.k * sizeof(uint64_t);
+        intact = fits(offset, header.rows, sizeof(int) + sizeof(uint64_t), size)
+                 && offset + header.rows * (sizeof(int) + sizeof(uint64_t)) == size;
+    }
+    if ( !intact ) throw std::runtime_error(std::format("[ERROR] Checkpoint is truncated: {}", path));
+
+    Checkpoint checkpoint;
+    checkpoint.scalar_bytes = header.scalar_bytes;
+    checkpoint.k = header.k;
+    checkpoint.dimensions = header.dimensions;
+    readAll(in, checkpoint.centers, header.k * header.dimensions);
+    readAll(in, checkpoint.counts, header.k);
+    readAll(in, checkpoint.labels, header.rows);
+    readAll(in, checkpoint.row_hashes, header.rows);
+    if ( !in ) throw std::runtime_error(std::format("[ERROR] Could not read file: {}", path));
+
+    const auto bad = std::ranges::find_if(checkpoint.labels, [&header](const int label) {
+        return label < 0 || static_cast<uint64_t>(label) >= header.k;
+    });
+    if ( bad != checkpoint.labels.end() ) throw std::runtime_error(std::format("[ERROR] Checkpoint has invalid labels: {}", path));
+    return checkpoint;
+}
+
+template<typename T>
+std::vector<uint64_t> Checkpoint::hashRows(const BasicDataset<T>& points, ThreadPool& pool) {
+    std::vector<uint64_t> hashes(points.rows());
+    const size_t grain = std::max<size_t>(1024, points.rows() / (std::max<size_t>(1, pool.numThreads()) * 4));
+    pool.parallelFor(0, points.rows(), grain, [&points, &hashes](const size_t start, const size_t end) {
+        for ( size_t i = start; i < end; ++i ) hashes[i] = hashBytes(points.row(i).data(), points.row(i).size_bytes());
+    });
+    return hashes;
+}
+
+template std::vector<uint64_t> Checkpoint::hashRows(const BasicDataset<float>&, ThreadPool&);
+template std::vector<uint64_t> Checkpoint::hashRows(const BasicDataset<double>&, ThreadPool&);
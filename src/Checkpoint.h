@@ -0,0 +1,53 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Dataset.h"
+#include "ThreadPool.h"
+
+/*
+ * fitted state of a model, enough to resume it on a dataset that changed a
+ * little: centers, points per center, the label of every row and a hash of
+ * every row's values, so rows that changed since can be told apart.
+ *
+ * file layout, all integers little endian:
+ *   Header
+ *   centers     k x dims doubles
+ *   counts      k u64
+ *   labels      rows i32
+ *   row hashes  rows u64
+ */
+struct Checkpoint {
+    static constexpr char MAGIC[8] = {'K', 'M', 'C', 'K', 'P', 'T', '\0', '\0'};
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t scalar_bytes;          // sizeof the scalar of the model that wrote it
+        uint64_t k;
+        uint64_t dimensions;
+        uint64_t rows;
+    };
+
+    uint32_t scalar_bytes = sizeof(double);
+    size_t k = 0;
+    size_t dimensions = 0;
+    std::vector<double> centers;        // k x dimensions, row-major
+    std::vector<uint64_t> counts;       // rows labelled with each center
+    std::vector<int> labels;
+    std::vector<uint64_t> row_hashes;
+
+    // writes through a temporary file, readers see the old or the new checkpoint
+    void save(const std::string& path) const;
+    [[nodiscard]] static Checkpoint load(const std::string& path);
+
+    // hash of every row's values, rows are hashed in parallel
+    template<typename T>
+    [[nodiscard]] static std::vector<uint64_t> hashRows(const BasicDataset<T>& points, ThreadPool& pool);
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,85 @@
+#include "ChromeTrace.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// the fit's phases on tid 0, worker w on tid w + 1
+constexpr int PID = 1;
+
+// complete event, times in milliseconds from the start of the fit
+std::string span(const std::string& name, const size_t tid, const double start_ms, const double duration_ms,
+                 const std::string& args = {}) {
+    return std::format(R"({{"name": "{}", "ph": "X", "pid": {}, "tid": {}, "ts": {:.3f}, "dur": {:.3f}, "args": {{{}}}}})",
+                       name, PID, tid, start_ms * 1e3, duration_ms * 1e3, args);
+}
+
+std::string counter(const std::string& name, const double at_ms, const double value) {
+    return std::format(R"({{"name": "{}", "ph": "C", "pid": {}, "ts": {:.3f}, "args": {{"{}": {}}}}})",
+                       name, PID, at_ms * 1e3, name, value);
+}
+
+std::string threadName(const size_t tid, const std::string& name) {
+    return std::format(R"({{"name": "thread_name", "ph": "M", "pid": {}, "tid": {}, "args": {{"name": "{}"}}}})",
+                       PID, tid, name);
+}
+
+} // namespace
+
+IterationObserver ChromeTrace::observer() {
+    return [this](const IterationMetrics& metrics) { record(metrics); };
+}
+
+void ChromeTrace::record(const IterationMetrics& metrics) { _iterations.push_back(metrics); }
+
+const std::vector<IterationMetrics>& ChromeTrace::iterations() const { return _iterations; }
+
+void ChromeTrace::save(const std::string& path) const {
+    std::vector<std::string> events;
+    events.push_back(threadName(0, "fit"));
+
+    size_t workers = 0;
+    for ( const auto& it : _iterations ) {
+        double at = it.start_ms;
+        events.push_back(span(std::format("iteration {}", it.iteration), 0, at, it.totalMs(),
+                              std::format(R"("changed": {}, "computed": {}, "reseeded": {}, "imbalance": {:.3f})",
+                                          it.changed, it.computed, it.reseeded, it.imbalance())));
+        events.push_back(span("assign", 0, at, it.assign_ms));
+        at += it.assign_ms;
+        events.push_back(span("merge", 0, at, it.merge_ms));
+        at += it.merge_ms;
+        if ( it.reduce_ms > 0.0 ) {
+            events.push_back(span("all-reduce", 0, at, it.reduce_ms));
+            at += it.reduce_ms;
+        }
+        events.push_back(span("update", 0, at, it.update_ms));
+
+        for ( size_t w = 0; w < it.workers.size(); ++w ) {
+            const auto& worker = it.workers[w];
+            if ( worker.chunks == 0 ) continue;
+            events.push_back(span("chunks", w + 1, worker.first_ms, worker.last_ms - worker.first_ms,
+                                  std::format(R"("busy_ms": {:.3f}, "rows": {}, "chunks": {})",
+                                              worker.busy_ms, worker.rows, worker.chunks)));
+        }
+        workers = std::max(workers, it.workers.size());
+
+        const double end = it.start_ms + it.totalMs();
+        events.push_back(counter("changed", end, static_cast<double>(it.changed)));
+        events.push_back(counter("inertia", end, it.inertia));
+        events.push_back(counter("max_shift", end, it.max_shift));
+    }
+    // the last slot belongs to the thread that called fit
+    for ( size_t w = 0; w < workers; ++w ) {
+        events.push_back(threadName(w + 1, w + 1 == workers ? "caller" : std::format("worker {}", w)));
+    }
+
+    std::ofstream out(path);
+    if ( !out.is_open() ) throw std::runtime_error(std::format("[ERROR] Could not create file: {}", path));
+    out << "{\"traceEvents\": [\n";
+    for ( size_t i = 0; i < events.size(); ++i ) out << "  " << events[i] << (i + 1 < events.size() ? ",\n" : "\n");
+    out << "], \"displayTimeUnit\": \"ms\"}\n";
+    if ( !out ) throw std::runtime_error(std::format("[ERROR] Could not write file: {}", path));
+}
@@ -0,0 +1,33 @@
+#ifndef CHROMETRACE_H
+#define CHROMETRACE_H
+
+#include <string>
+#include <vector>
+
+#include "FitMetrics.h"
+
+/*
+ * collects the iterations of a fit and writes them in the trace event format
+ * that chrome://tracing and ui.perfetto.dev open: one track with the phases
+ * of every iteration, one track per worker spanning its chunks, and counters
+ * for changed points, inertia and center shift.
+ *
+ *   ChromeTrace trace;
+ *   model.observe(trace.observer());
+ *   model.fit(points, pool);
+ *   trace.save("fit.json");
+ */
+class ChromeTrace {
+public:
+    // records into this trace, which has to outlive the fit
+    [[nodiscard]] IterationObserver observer();
+    void record(const IterationMetrics& metrics);
+
+    [[nodiscard]] const std::vector<IterationMetrics>& iterations() const;
+    void save(const std::string& path) const;
+
+private:
+    std::vector<IterationMetrics> _iterations;
+};
+
+#endif // CHROMETRACE_H
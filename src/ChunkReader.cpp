@@ -0,0 +1,225 @@
+#include "ChunkReader.h"
+
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "CsvParsing.h"
+
+namespace {
+
+// bytes asked from the file per read
+constexpr size_t READ_BYTES = 1 << 20;
+
+} // namespace
+
+ChunkReader::ChunkReader(std::string path, const size_t chunk_rows) :
+                _path(std::move(path)),
+                _chunk_rows(chunk_rows),
+                _bytes(READ_BYTES)
+{
+    if ( chunk_rows == 0 ) throw std::invalid_argument("[ERROR] Chunks need at least one row.");
+
+    _fd = ::open(_path.c_str(), O_RDONLY);
+    if ( _fd < 0 ) throw std::runtime_error(std::format("[ERROR] Could not open file: {}", _path));
+    try {
+        ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        //-- header and first row, to find the numeric columns
+        while ( !std::memchr(_bytes.data(), '\n', _end) && readMore() ) {}
+        const char* p = _bytes.data();
+        const char* end = p + _end;
+        if ( p == end ) throw std::invalid_argument("[ERROR] cannot read header.");
+
+        const auto [header_begin, header_end] = CsvParsing::nextLine(p, end);
+        for ( const auto cell : CsvParsing::splitCells(header_begin, header_end) ) _header.emplace_back(cell);
+        _body_offset = static_cast<size_t>(p - _bytes.data());
+
+        std::vector<std::string_view> first_cells;
+        while ( !std::memchr(_bytes.data() + _body_offset, '\n', _end - _body_offset) && readMore() ) {}
+        p = _bytes.data() + _body_offset;
+        end = _bytes.data() + _end;
+        if ( p < end ) {
+            const auto [first_begin, first_end] = CsvParsing::nextLine(p, end);
+            first_cells = CsvParsing::splitCells(first_begin, first_end);
+        }
+        _role = CsvParsing::columnRoles(_header, first_cells, {}, _numeric_fields);
+
+        for ( auto& buffer : _buffers ) buffer = Dataset(0, _numeric_fields.size());
+        rewind();
+        _reader = std::thread(&ChunkReader::readerLoop, this);
+    } catch (...) {
+        // the destructor does not run for a throwing constructor
+        ::close(_fd);
+        _fd = -1;
+        throw;
+    }
+}
+
+ChunkReader::~ChunkReader() {
+    if ( _reader.joinable() ) {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        _reader.join();
+    }
+    if ( _fd >= 0 ) ::close(_fd);
+}
+
+const std::vector<std::string>& ChunkReader::numericFields() const { return _numeric_fields; }
+size_t ChunkReader::dimensions() const { return _numeric_fields.size(); }
+size_t ChunkReader::chunkRows() const { return _chunk_rows; }
+size_t ChunkReader::firstRow() const { return _first_row; }
+
+void ChunkReader::readerLoop() {
+    std::unique_lock lock(_mutex);
+    while ( true ) {
+        _wake.wait(lock, [this] { return _stop || _request >= 0; });
+        if ( _stop ) return;
+
+        const int target = _request;
+        lock.unlock();
+        size_t rows = 0;
+        std::exception_ptr error;
+        try { rows = fill(_buffers[target]); }
+        catch ( ... ) { error = std::current_exception(); }
+        lock.lock();
+
+        _request = -1;
+        _filled_rows = rows;
+        _error = error;
+        _filled = true;
+        _wake.notify_all();
+    }
+}
+
+void ChunkReader::prefetch(const int target) {
+    {
+        std::lock_guard lock(_mutex);
+        _request = target;
+        _filled = false;
+    }
+    _pending = true;
+    _wake.notify_all();
+}
+
+size_t ChunkReader::collect() {
+    // rows of the prefetched chunk, rethrows what the reader thread hit
+    std::unique_lock lock(_mutex);
+    _wake.wait(lock, [this] { return _filled; });
+    _pending = false;
+    if ( _error ) std::rethrow_exception(std::exchange(_error, nullptr));
+    return _filled_rows;
+}
+
+void ChunkReader::wait() {
+    // drops a prefetched chunk, only for callers that move the read position anyway
+    if ( _pending ) collect();
+}
+
+void ChunkReader::rewind() {
+    wait();
+    if ( ::lseek(_fd, static_cast<off_t>(_body_offset), SEEK_SET) < 0 ) {
+        throw std::runtime_error(std::format("[ERROR] Could not seek in file: {}", _path));
+    }
+    _begin = _end = 0;
+    _eof = false;
+    _done = false;
+    _filling = 0;
+    _first_row = _next_row = 0;
+}
+
+bool ChunkReader::readMore() {
+    /*
+     * keeps the unread bytes, moves them to the front and appends what the file gives.
+     * grows the buffer only for lines longer than it.
+     */
+    if ( _eof ) return false;
+
+    if ( _begin > 0 ) {
+        std::memmove(_bytes.data(), _bytes.data() + _begin, _end - _begin);
+        _end -= _begin;
+        _begin = 0;
+    }
+    if ( _end == _bytes.size() ) _bytes.resize(_bytes.size() * 2);
+
+    const ssize_t got = ::read(_fd, _bytes.data() + _end, _bytes.size() - _end);
+    if ( got < 0 ) throw std::runtime_error(std::format("[ERROR] Could not read file: {}", _path));
+    if ( got == 0 ) _eof = true;
+    _end += static_cast<size_t>(got);
+    return got > 0;
+}
+
+size_t ChunkReader::fill(Dataset& buffer) {
+    buffer.resize(_chunk_rows);
+
+    size_t rows = 0;
+    while ( rows < _chunk_rows ) {
+        // make sure a whole line is buffered
+        const char* newline = static_cast<const char*>(std::memchr(_bytes.data() + _begin, '\n', _end - _begin));
+        if ( !newline && readMore() ) continue;
+        if ( !newline && _begin == _end ) break;   // end of file
+
+        const char* p = _bytes.data() + _begin;
+        const char* stop = newline ? newline + 1 : _bytes.data() + _end;
+        const auto [line_begin, line_end] = CsvParsing::nextLine(p, stop);
+        _begin = static_cast<size_t>(p - _bytes.data());
+        if ( line_end == line_begin ) continue;
+
+        const auto row = buffer.row(rows);
+        CsvParsing::parseLine(line_begin, line_end, _role, row.data(), [](size_t, std::string_view) {});
+        if ( !_scaler.center.empty() ) _scaler.transform(row);
+        ++rows;
+    }
+
+    buffer.resize(rows);
+    return rows;
+}
+
+Dataset* ChunkReader::next() {
+    if ( _done ) return nullptr;
+
+    // first call after a rewind reads in the foreground
+    const size_t rows = _pending ? collect() : fill(_buffers[_filling]);
+    if ( rows == 0 ) {
+        _done = true;
+        return nullptr;
+    }
+
+    const int ready = _filling;
+    _first_row = _next_row;
+    _next_row += rows;
+
+    // start reading the following chunk into the other buffer
+    _filling = 1 - ready;
+    prefetch(_filling);
+
+    return &_buffers[ready];
+}
+
+void ChunkReader::setScaler(Scaler scaler) {
+    if ( !scaler.center.empty() && scaler.dimensions() != dimensions() ) {
+        throw std::invalid_argument("[ERROR] Scaler was fitted on a different number of columns.");
+    }
+    wait();     // the reader thread may be scaling with the old one
+    _scaler = std::move(scaler);
+    rewind();
+}
+
+const Scaler& ChunkReader::computeScaling(const Scaling scaling) {
+    setScaler({});
+
+    ColumnStats stats(dimensions(), scaling == Scaling::Robust);
+    while ( const Dataset* chunk = next() ) stats.merge(ColumnStats::compute(*chunk, scaling == Scaling::Robust));
+    if ( stats.rows == 0 ) throw std::invalid_argument("[ERROR] File has no rows.");
+
+    setScaler(Scaler::fit(stats, scaling));
+    return _scaler;
+}
+
+const Scaler& ChunkReader::scaler() const { return _scaler; }
@@ -0,0 +1,93 @@
+#ifndef CHUNKREADER_H
+#define CHUNKREADER_H
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Dataset.h"
+#include "Scaler.h"
+
+/*
+ * reads the numeric columns of a csv file `chunk_rows` rows at a time.
+ * two chunk buffers are kept: while the caller works on one, the next is read
+ * and parsed by the reader's own background thread, which lives as long as
+ * the reader. memory use is bounded by the chunk size, not by the file size.
+ */
+class ChunkReader {
+    std::string _path;
+    int _fd = -1;
+    size_t _chunk_rows;
+
+    std::vector<std::string> _header;
+    std::vector<std::string> _numeric_fields;
+    std::vector<int> _role;             // see CsvParsing::columnRoles
+    size_t _body_offset = 0;            // first byte after the header
+
+    //-- raw bytes between reads
+    std::vector<char> _bytes;
+    size_t _begin = 0;
+    size_t _end = 0;
+    bool _eof = false;
+
+    //-- double buffering
+    Dataset _buffers[2];
+    int _filling = 0;                   // buffer the pending read writes to
+    bool _pending = false;              // a prefetch was started and not collected yet
+    bool _done = false;
+    size_t _first_row = 0;              // of the chunk handed out last
+    size_t _next_row = 0;
+
+    //-- prefetch thread, fills buffer _request when it is set
+    std::thread _reader;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    int _request = -1;
+    bool _filled = false;
+    bool _stop = false;
+    size_t _filled_rows = 0;
+    std::exception_ptr _error;
+
+    //-- optional scaling applied to every chunk, none while it has no columns
+    Scaler _scaler;
+
+public:
+    ChunkReader(std::string path, size_t chunk_rows);
+    ~ChunkReader();
+
+    ChunkReader(const ChunkReader&) = delete;
+    ChunkReader& operator=(const ChunkReader&) = delete;
+
+    // getters
+    [[nodiscard]] const std::vector<std::string>& numericFields() const;
+    [[nodiscard]] size_t dimensions() const;
+    [[nodiscard]] size_t chunkRows() const;
+    [[nodiscard]] size_t firstRow() const;  // index in the file of the current chunk's first row
+
+    // next chunk, or nullptr at the end of the file.
+    // the chunk stays valid until the following call to next or rewind.
+    Dataset* next();
+
+    // back to the first row
+    void rewind();
+
+    // scales every chunk with `scaler`. rewinds, so no chunk is read with the old scaling
+    void setScaler(Scaler scaler);
+    // one pass over the file merging the column statistics of every chunk, then setScaler
+    const Scaler& computeScaling(Scaling scaling = Scaling::MinMax);
+    // what chunks are scaled with, e.g. to save it for predict
+    [[nodiscard]] const Scaler& scaler() const;
+
+private:
+    size_t fill(Dataset& buffer);
+    bool readMore();
+    void prefetch(int target);
+    size_t collect();
+    void wait();
+    void readerLoop();
+};
+
+#endif // CHUNKREADER_H
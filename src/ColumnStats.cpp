@@ -0,0 +1,163 @@
+#include "ColumnStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+//-- QuantileSketch
+
+QuantileSketch::QuantileSketch(const size_t capacity) : _capacity(std::max<size_t>(capacity, 2)), _levels(1) {}
+
+void QuantileSketch::add(const double value) {
+    _levels[0].push_back(value);
+    ++_count;
+    if ( _levels[0].size() >= _capacity ) compact(0);
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if ( other._levels.size() > _levels.size() ) _levels.resize(other._levels.size());
+    for ( size_t l = 0; l < other._levels.size(); ++l ) {
+        _levels[l].insert(_levels[l].end(), other._levels[l].begin(), other._levels[l].end());
+    }
+    _count += other._count;
+
+    // lower levels first, their halves land on the levels above
+    for ( size_t l = 0; l < _levels.size(); ++l ) {
+        if ( _levels[l].size() >= _capacity ) compact(l);
+    }
+}
+
+void QuantileSketch::compact(const size_t level) {
+    if ( level + 1 == _levels.size() ) _levels.emplace_back();
+    auto& items = _levels[level];
+    std::ranges::sort(items);
+
+    // an odd largest item stays, every other one of the rest goes up at twice the weight
+    const bool odd_out = items.size() % 2 != 0;
+    const double left = odd_out ? items.back() : 0.0;
+    auto& above = _levels[level + 1];
+    for ( size_t p = 0; p < items.size() / 2; ++p ) above.push_back(items[2 * p + (_odd ? 1 : 0)]);
+    _odd = !_odd;
+
+    items.clear();
+    if ( odd_out ) items.push_back(left);
+
+    if ( above.size() >= _capacity ) compact(level + 1);
+}
+
+double QuantileSketch::quantile(const double q) const {
+    if ( _count == 0 ) return std::numeric_limits<double>::quiet_NaN();
+
+    std::vector<std::pair<double, size_t>> weighted;
+    for ( size_t l = 0; l < _levels.size(); ++l ) {
+        for ( const double value : _levels[l] ) weighted.emplace_back(value, size_t{1} << l);
+    }
+    std::ranges::sort(weighted);
+
+    size_t total = 0;
+    for ( const auto& item : weighted ) total += item.second;
+
+    const double rank = std::clamp(q, 0.0, 1.0) * static_cast<double>(total);
+    size_t seen = 0;
+    for ( const auto& [value, weight] : weighted ) {
+        seen += weight;
+        if ( static_cast<double>(seen) > rank ) return value;
+    }
+    return weighted.back().first;
+}
+
+size_t QuantileSketch::count() const { return _count; }
+
+//-- ColumnStats
+
+ColumnStats::ColumnStats(const size_t dimensions, const bool quantiles)
+    : min(dimensions, std::numeric_limits<double>::infinity()),
+      max(dimensions, -std::numeric_limits<double>::infinity()),
+      mean(dimensions, 0.0),
+      m2(dimensions, 0.0) {
+    if ( quantiles ) sketches.resize(dimensions);
+}
+
+size_t ColumnStats::dimensions() const { return mean.size(); }
+
+double ColumnStats::variance(const size_t column) const {
+    return rows > 0 ? m2[column] / static_cast<double>(rows) : 0.0;
+}
+
+double ColumnStats::stddev(const size_t column) const { return std::sqrt(variance(column)); }
+
+double ColumnStats::quantile(const size_t column, const double q) const {
+    if ( sketches.empty() ) throw std::logic_error("[ERROR] Column statistics were computed without quantiles.");
+    return sketches[column].quantile(q);
+}
+
+template<typename T>
+void ColumnStats::add(const T* row) {
+    ++rows;
+    const double inverse = 1.0 / static_cast<double>(rows);
+
+    for ( size_t c = 0; c < mean.size(); ++c ) {
+        const double x = static_cast<double>(row[c]);
+        min[c] = std::min(min[c], x);
+        max[c] = std::max(max[c], x);
+
+        // welford: the mean moves by delta / n, m2 grows by delta times the distance to the new mean
+        const double delta = x - mean[c];
+        mean[c] += delta * inverse;
+        m2[c] += delta * (x - mean[c]);
+    }
+    for ( size_t c = 0; c < sketches.size(); ++c ) sketches[c].add(static_cast<double>(row[c]));
+}
+
+void ColumnStats::merge(const ColumnStats& other) {
+    if ( other.rows == 0 ) return;
+    if ( rows == 0 ) {
+        *this = other;
+        return;
+    }
+
+    // chan et al: the combined m2 adds the spread between the two means
+    const double a = static_cast<double>(rows), b = static_cast<double>(other.rows);
+    const double n = a + b;
+    for ( size_t c = 0; c < mean.size(); ++c ) {
+        min[c] = std::min(min[c], other.min[c]);
+        max[c] = std::max(max[c], other.max[c]);
+
+        const double delta = other.mean[c] - mean[c];
+        mean[c] += delta * b / n;
+        m2[c] += other.m2[c] + delta * delta * a * b / n;
+    }
+    for ( size_t c = 0; c < sketches.size() && c < other.sketches.size(); ++c ) sketches[c].merge(other.sketches[c]);
+    rows += other.rows;
+}
+
+template<typename T>
+ColumnStats ColumnStats::compute(const BasicDataset<T>& data, const bool quantiles) {
+    ColumnStats stats(data.dimensions(), quantiles);
+    for ( size_t i = 0; i < data.rows(); ++i ) stats.add(data.row(i).data());
+    return stats;
+}
+
+template<typename T>
+ColumnStats ColumnStats::compute(const BasicDataset<T>& data, ThreadPool& pool, const bool quantiles) {
+    const size_t dims = data.dimensions();
+    return pool.parallelReduce(size_t{0}, data.rows(), CHUNK_ROWS, ColumnStats(dims, quantiles),
+        [&data, dims, quantiles](const size_t begin, const size_t end) {
+            ColumnStats partial(dims, quantiles);
+            for ( size_t i = begin; i < end; ++i ) partial.add(data.row(i).data());
+            return partial;
+        },
+        [](ColumnStats total, const ColumnStats& partial) {
+            total.merge(partial);
+            return total;
+        });
+}
+
+template void ColumnStats::add(const float*);
+template void ColumnStats::add(const double*);
+template ColumnStats ColumnStats::compute(const BasicDataset<float>&, bool);
+template ColumnStats ColumnStats::compute(const BasicDataset<double>&, bool);
+template ColumnStats ColumnStats::compute(const BasicDataset<float>&, ThreadPool&, bool);
+template ColumnStats ColumnStats::compute(const BasicDataset<double>&, ThreadPool&, bool);
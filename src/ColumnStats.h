@@ -0,0 +1,80 @@
+#ifndef COLUMNSTATS_H
+#define COLUMNSTATS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Dataset.h"
+#include "ThreadPool.h"
+
+/*
+ * mergeable quantile sketch of one column. level l holds items that stand for
+ * 2^l values; a full level is sorted and every other item moves up a level.
+ * ranks are off by about levels / capacity of the count, and memory stays at
+ * capacity items per level however many values are added.
+ */
+class QuantileSketch {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 256;
+
+    explicit QuantileSketch(size_t capacity = DEFAULT_CAPACITY);
+
+    void add(double value);
+    void merge(const QuantileSketch& other);
+
+    // value at rank q * count, q in [0, 1]. nan when empty
+    [[nodiscard]] double quantile(double q) const;
+    [[nodiscard]] size_t count() const;
+
+private:
+    size_t _capacity;
+    size_t _count = 0;
+    bool _odd = false;                  // which half the next compaction keeps
+    std::vector<std::vector<double>> _levels;
+
+    void compact(size_t level);
+};
+
+/*
+ * per column statistics of a dataset in one pass: min, max, and mean and
+ * variance by welford's update, plus optional quantile sketches. partial
+ * statistics of disjoint rows merge exactly, except for the sketches.
+ */
+struct ColumnStats {
+    size_t rows = 0;
+    std::vector<double> min;
+    std::vector<double> max;
+    std::vector<double> mean;
+    std::vector<double> m2;             // sum of squared differences from the mean
+    std::vector<QuantileSketch> sketches; // one per column, empty unless asked for
+
+    ColumnStats() = default;
+    ColumnStats(size_t dimensions, bool quantiles);
+
+    [[nodiscard]] size_t dimensions() const;
+    [[nodiscard]] double variance(size_t column) const;    // population variance
+    [[nodiscard]] double stddev(size_t column) const;
+    [[nodiscard]] double quantile(size_t column, double q) const;
+
+    template<typename T>
+    void add(const T* row);
+    void merge(const ColumnStats& other);
+
+    // the pool overload gives every chunk of rows its own partial, merged in row order
+    template<typename T>
+    [[nodiscard]] static ColumnStats compute(const BasicDataset<T>& data, bool quantiles = false);
+    template<typename T>
+    [[nodiscard]] static ColumnStats compute(const BasicDataset<T>& data, ThreadPool& pool, bool quantiles = false);
+
+    // rows per partial of the parallel pass
+    static constexpr size_t CHUNK_ROWS = 1 << 14;
+};
+
+extern template void ColumnStats::add(const float*);
+extern template void ColumnStats::add(const double*);
+extern template ColumnStats ColumnStats::compute(const BasicDataset<float>&, bool);
+extern template ColumnStats ColumnStats::compute(const BasicDataset<double>&, bool);
+extern template ColumnStats ColumnStats::compute(const BasicDataset<float>&, ThreadPool&, bool);
+extern template ColumnStats ColumnStats::compute(const BasicDataset<double>&, ThreadPool&, bool);
+
+#endif // COLUMNSTATS_H
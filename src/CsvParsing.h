@@ -0,0 +1,121 @@
+#ifndef CSVPARSING_H
+#define CSVPARSING_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// low level csv helpers shared by CsvReader and ChunkReader
+namespace CsvParsing {
+
+// end of the cell starting at `p`, honouring double quotes
+inline const char* cellEnd(const char* p, const char* end) {
+    bool quoted = false;
+    for ( ; p < end; ++p ) {
+        if ( *p == '"' ) quoted = !quoted;
+        else if ( *p == ',' && !quoted ) return p;
+    }
+    return end;
+}
+
+// cell content without surrounding quotes
+inline std::string_view unquote(const char* begin, const char* end) {
+    if ( end - begin >= 2 && *begin == '"' && *(end - 1) == '"' ) return {begin + 1, static_cast<size_t>(end - begin - 2)};
+    return {begin, static_cast<size_t>(end - begin)};
+}
+
+inline bool parseDouble(std::string_view cell, double& value) {
+    while ( !cell.empty() && cell.front() == ' ' ) cell.remove_prefix(1);
+    while ( !cell.empty() && cell.back() == ' ' ) cell.remove_suffix(1);
+    if ( !cell.empty() && cell.front() == '+' ) cell.remove_prefix(1);
+
+    const auto [ptr, ec] = std::from_chars(cell.data(), cell.data() + cell.size(), value);
+    return ec == std::errc() && ptr == cell.data() + cell.size() && !cell.empty();
+}
+
+// [begin, end) of the next line, without the line break. advances p past it
+inline std::pair<const char*, const char*> nextLine(const char*& p, const char* end) {
+    const char* begin = p;
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    const char* stop = newline ? newline : end;
+    p = newline ? newline + 1 : end;
+    if ( stop > begin && *(stop - 1) == '\r' ) --stop;
+    return {begin, stop};
+}
+
+inline std::vector<std::string_view> splitCells(const char* begin, const char* end) {
+    std::vector<std::string_view> cells;
+    const char* p = begin;
+    while ( true ) {
+        const char* stop = cellEnd(p, end);
+        cells.push_back(unquote(p, stop));
+        if ( stop == end ) break;
+        p = stop + 1;
+    }
+    return cells;
+}
+
+/*
+ * role of every column: -1 skipped, >= 0 numeric index, <= -2 text index.
+ * text columns are the requested ones, numeric columns the others whose cell
+ * in `first_row` parses completely. their names go to numeric_fields.
+ */
+inline std::vector<int> columnRoles(const std::vector<std::string>& header, const std::vector<std::string_view>& first_row,
+                                    const std::vector<std::string>& text_fields, std::vector<std::string>& numeric_fields) {
+    std::vector<int> role(header.size(), -1);
+
+    for ( size_t t = 0; t < text_fields.size(); ++t ) {
+        const auto it = std::find(header.begin(), header.end(), text_fields[t]);
+        if ( it == header.end() ) throw std::invalid_argument(std::format("[ERROR] Column not in header: {}", text_fields[t]));
+        role[it - header.begin()] = -2 - static_cast<int>(t);
+    }
+
+    numeric_fields.clear();
+    for ( size_t c = 0; c < std::min(header.size(), first_row.size()); ++c ) {
+        double ignored;
+        if ( role[c] == -1 && parseDouble(first_row[c], ignored) ) {
+            role[c] = static_cast<int>(numeric_fields.size());
+            numeric_fields.push_back(header[c]);
+        }
+    }
+    if ( numeric_fields.empty() ) throw std::invalid_argument("[ERROR] No numeric columns found.");
+
+    return role;
+}
+
+/*
+ * parses one line into `values`, by column role:
+ * role >= 0 -> numeric index, role <= -2 -> text index (-2 - role), -1 skipped.
+ * text cells are reported through on_text(index, view). missing cells are empty.
+ */
+template<class OnText>
+void parseLine(const char* line_begin, const char* line_end, const std::vector<int>& role, double* values, OnText&& on_text) {
+    const char* cell = line_begin;
+    for ( size_t column = 0; column < role.size(); ++column ) {
+        const char* stop = line_end;
+        std::string_view content(line_end, 0);
+        if ( cell <= line_end ) {
+            stop = cellEnd(cell, line_end);
+            content = unquote(cell, stop);
+        }
+
+        if ( role[column] >= 0 ) {
+            double value;
+            values[role[column]] = parseDouble(content, value) ? value : 0.0;
+        }
+        else if ( role[column] <= -2 ) {
+            on_text(static_cast<size_t>(-2 - role[column]), content);
+        }
+        cell = stop + 1;
+    }
+}
+
+} // namespace CsvParsing
+
+#endif // CSVPARSING_H
@@ -0,0 +1,114 @@
+#include "CsvReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <numeric>
+#include <stdexcept>
+
+#include "CsvParsing.h"
+
+namespace {
+
+// smallest piece of the file handed to one task
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+
+} // namespace
+
+size_t CsvTable::rows() const { return _features.rows(); }
+const std::vector<std::string>& CsvTable::header() const { return _header; }
+const std::vector<std::string>& CsvTable::numericFields() const { return _numeric_fields; }
+const std::vector<std::string>& CsvTable::textFields() const { return _text_fields; }
+const Dataset& CsvTable::features() const { return _features; }
+Dataset& CsvTable::features() { return _features; }
+
+std::string_view CsvTable::text(const size_t row, const size_t field) const {
+    const auto& ref = _text[row * _text_fields.size() + field];
+    return {_file->data() + ref.offset, ref.length};
+}
+
+std::string_view CsvTable::text(const size_t row, const std::string& field) const {
+    const auto it = std::ranges::find(_text_fields, field);
+    if ( it == _text_fields.end() ) throw std::invalid_argument(std::format("[ERROR] Column was not loaded: {}", field));
+    return text(row, static_cast<size_t>(it - _text_fields.begin()));
+}
+
+CsvTable CsvReader::read(const std::string& path, ThreadPool& pool,
+                         const std::vector<std::string>& text_fields, const int limit) {
+    CsvTable table;
+    table._file = std::make_shared<const MappedFile>(path);
+
+    const char* const base = table._file->data();
+    const char* const end = base + table._file->size();
+    const char* p = base;
+
+    //-- header
+    if ( p == end ) throw std::invalid_argument("[ERROR] cannot read header.");
+    const auto [header_begin, header_end] = CsvParsing::nextLine(p, end);
+    for ( const auto cell : CsvParsing::splitCells(header_begin, header_end) ) table._header.emplace_back(cell);
+    const char* const body = p;
+
+    //-- column roles, numeric columns are detected on the first data row
+    std::vector<std::string_view> first_cells;
+    if ( p < end ) {
+        const char* q = p;
+        const auto [first_begin, first_end] = CsvParsing::nextLine(q, end);
+        first_cells = CsvParsing::splitCells(first_begin, first_end);
+    }
+    table._text_fields = text_fields;
+    const auto role = CsvParsing::columnRoles(table._header, first_cells, text_fields, table._numeric_fields);
+
+    //-- split the body in chunks that start at a line
+    const size_t body_size = static_cast<size_t>(end - body);
+    const size_t wanted = std::max<size_t>(1, std::min(pool.numThreads() * 4, body_size / MIN_CHUNK_BYTES + 1));
+    std::vector<const char*> bounds = {body};
+    for ( size_t c = 1; c < wanted; ++c ) {
+        const char* guess = body + body_size * c / wanted;
+        if ( guess <= bounds.back() ) continue;
+        const char* newline = static_cast<const char*>(std::memchr(guess, '\n', end - guess));
+        if ( !newline ) break;
+        bounds.push_back(newline + 1);
+    }
+    bounds.push_back(end);
+    const size_t chunks = bounds.size() - 1;
+
+    //-- pass 1: rows per chunk
+    std::vector<size_t> first_row(chunks + 1, 0);
+    pool.parallelFor(0, chunks, 1, [&bounds, &first_row](const size_t c, size_t) {
+        const char* to = bounds[c + 1];
+        size_t rows = 0;
+        for ( const char* q = bounds[c]; q < to; ) {
+            const auto [line_begin, line_end] = CsvParsing::nextLine(q, to);
+            if ( line_end > line_begin ) ++rows;   // skip blank lines
+        }
+        first_row[c + 1] = rows;
+    });
+    std::partial_sum(first_row.begin(), first_row.end(), first_row.begin());
+
+    size_t total = first_row[chunks];
+    if ( limit >= 0 ) total = std::min(total, static_cast<size_t>(limit));
+
+    table._features = Dataset(total, table._numeric_fields.size());
+    table._text.resize(total * table._text_fields.size());
+
+    //-- pass 2: parse every chunk straight into its rows
+    pool.parallelFor(0, chunks, 1, [&](const size_t c, size_t) {
+        const size_t text_count = table._text_fields.size();
+        const char* to = bounds[c + 1];
+        size_t row = first_row[c];
+
+        for ( const char* q = bounds[c]; q < to && row < total; ) {
+            const auto [line_begin, line_end] = CsvParsing::nextLine(q, to);
+            if ( line_end == line_begin ) continue;
+
+            CsvTable::TextRef* refs = table._text.data() + row * text_count;
+            CsvParsing::parseLine(line_begin, line_end, role, table._features.row(row).data(),
+                [&](const size_t field, const std::string_view content) {
+                    refs[field] = {static_cast<uint64_t>(content.data() - base), static_cast<uint32_t>(content.size())};
+                });
+            ++row;
+        }
+    });
+
+    return table;
+}
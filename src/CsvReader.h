@@ -0,0 +1,64 @@
+#ifndef CSVREADER_H
+#define CSVREADER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Dataset.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+/*
+ * a parsed csv file. numeric columns are stored in a Dataset, the requested
+ * text columns only as offsets into the mapped file, which the table keeps alive.
+ */
+class CsvTable {
+public:
+    struct TextRef {
+        uint64_t offset;
+        uint32_t length;
+    };
+
+    CsvTable() = default;
+
+    // getters
+    [[nodiscard]] size_t rows() const;
+    [[nodiscard]] const std::vector<std::string>& header() const;
+    [[nodiscard]] const std::vector<std::string>& numericFields() const;
+    [[nodiscard]] const std::vector<std::string>& textFields() const;
+    [[nodiscard]] const Dataset& features() const;
+    [[nodiscard]] Dataset& features();
+
+    // text of a requested column, by position in textFields() or by name
+    [[nodiscard]] std::string_view text(size_t row, size_t field) const;
+    [[nodiscard]] std::string_view text(size_t row, const std::string& field) const;
+
+private:
+    friend class CsvReader;
+    friend class FeatureCache;
+
+    std::shared_ptr<const MappedFile> _file;
+    std::vector<std::string> _header;
+    std::vector<std::string> _numeric_fields;
+    std::vector<std::string> _text_fields;
+    Dataset _features;                  // raw values, rows x numeric fields
+    std::vector<TextRef> _text;         // rows x text fields
+};
+
+class CsvReader {
+public:
+    /*
+     * maps `path` and parses it in parallel chunks.
+     * first line must be a header. numeric columns are detected on the first
+     * data row; cells that fail to parse later are read as 0.
+     * quoted cells may contain commas but not line breaks.
+     * limit -> max rows to read, -1 for all.
+     */
+    [[nodiscard]] static CsvTable read(const std::string& path, ThreadPool& pool,
+                                       const std::vector<std::string>& text_fields, int limit = -1);
+};
+
+#endif // CSVREADER_H
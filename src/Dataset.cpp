@@ -0,0 +1,94 @@
+#include "Dataset.h"
+
+#include <format>
+#include <iostream>
+#include <stdexcept>
+
+
+template<typename T>
+BasicDataset<T>::BasicDataset(const size_t rows, const size_t dimensions) :
+                _rows(rows),
+                _dimensions(dimensions),
+                _values(rows * dimensions, T{0}),
+                _labels(rows, -1)
+{
+    if ( dimensions == 0 ) throw std::invalid_argument("[ERROR] Dataset needs at least one dimension.");
+}
+
+template<typename T>
+BasicDataset<T>::BasicDataset(T* values, const size_t rows, const size_t dimensions, std::shared_ptr<void> owner) :
+                _rows(rows),
+                _dimensions(dimensions),
+                _external(values),
+                _owner(std::move(owner)),
+                _labels(rows, -1)
+{
+    if ( dimensions == 0 ) throw std::invalid_argument("[ERROR] Dataset needs at least one dimension.");
+}
+
+template<typename T> size_t BasicDataset<T>::rows() const { return _rows; }
+template<typename T> size_t BasicDataset<T>::dimensions() const { return _dimensions; }
+template<typename T> bool BasicDataset<T>::empty() const { return _rows == 0; }
+
+template<typename T> std::span<const T> BasicDataset<T>::values() const { return {base(), _rows * _dimensions}; }
+template<typename T> std::span<T> BasicDataset<T>::values() { return {base(), _rows * _dimensions}; }
+
+template<typename T> bool BasicDataset<T>::isView() const { return _external != nullptr; }
+template<typename T> bool BasicDataset<T>::isShared() const { return _shared; }
+
+template<typename T>
+BasicDataset<T> BasicDataset<T>::share() const {
+    BasicDataset view(const_cast<T*>(base()), _rows, _dimensions, _owner);
+    view._shared = true;
+    return view;
+}
+
+template<typename T>
+void BasicDataset<T>::own() {
+    if ( !_external ) return;
+    _values.assign(_external, _external + _rows * _dimensions);
+    _external = nullptr;
+    _owner.reset();
+    _shared = false;
+}
+
+template<typename T> std::span<const int> BasicDataset<T>::labels() const { return {_labels.data(), _labels.size()}; }
+template<typename T> std::span<int> BasicDataset<T>::labels() { return {_labels.data(), _labels.size()}; }
+
+template<typename T>
+size_t BasicDataset<T>::append(const std::span<const T> cords) {
+    if ( _dimensions == 0 ) _dimensions = cords.size();
+    if ( cords.size() != _dimensions ) {
+        throw std::invalid_argument(std::format("[ERROR] Expected {} dimensions, got {}.", _dimensions, cords.size()));
+    }
+
+    own();
+    _values.insert(_values.end(), cords.begin(), cords.end());
+    _labels.push_back(-1);
+    return _rows++;
+}
+
+template<typename T>
+void BasicDataset<T>::reserve(const size_t rows) {
+    own();
+    _values.reserve(rows * _dimensions);
+    _labels.reserve(rows);
+}
+
+template<typename T>
+void BasicDataset<T>::resize(const size_t rows) {
+    own();
+    _values.resize(rows * _dimensions, T{0});
+    _labels.resize(rows, -1);
+    _rows = rows;
+}
+
+template<typename T>
+void BasicDataset<T>::display(const size_t i) const {
+    std::cout << "Point: " << label(i) << std::endl;
+    for ( const T v : row(i) ) std::cout << v << " ";
+    std::cout << std::endl;
+}
+
+template class BasicDataset<float>;
+template class BasicDataset<double>;
@@ -0,0 +1,90 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+/*
+ * all points of a dataset stored in one contiguous row-major buffer.
+ * cluster labels live in a separate array so the coordinates can be shared
+ * read-only between threads while labels are written.
+ * the values can also live in memory owned by someone else (e.g. a mapped
+ * cache file); copies of such a dataset share that memory.
+ * T is the stored scalar, float or double.
+ */
+template<typename T = double>
+class BasicDataset {
+    size_t _rows = 0;
+    size_t _dimensions = 0;
+    AlignedVector<T> _values;           // rows x dimensions, row-major
+    T* _external = nullptr;             // used instead of _values when set
+    std::shared_ptr<void> _owner;       // keeps _external alive
+    bool _shared = false;               // _external belongs to another dataset, see share()
+    std::vector<int> _labels;           // assigned group of every row
+
+    [[nodiscard]] T* base() { return _external ? _external : _values.data(); }
+    [[nodiscard]] const T* base() const { return _external ? _external : _values.data(); }
+    void own();     // copies external values into _values
+
+public:
+    using value_type = T;
+
+    BasicDataset() = default;
+    BasicDataset(size_t rows, size_t dimensions);
+    // view over rows x dimensions values that `owner` keeps alive
+    BasicDataset(T* values, size_t rows, size_t dimensions, std::shared_ptr<void> owner);
+    // copy with every value converted to T, labels kept
+    template<typename U>
+    explicit BasicDataset(const BasicDataset<U>& other);
+
+    // getters
+    [[nodiscard]] size_t rows() const;
+    [[nodiscard]] size_t dimensions() const;
+    [[nodiscard]] bool empty() const;
+
+    [[nodiscard]] std::span<const T> row(size_t i) const { return {base() + i * _dimensions, _dimensions}; }
+    [[nodiscard]] std::span<T> row(size_t i) { return {base() + i * _dimensions, _dimensions}; }
+
+    [[nodiscard]] std::span<const T> values() const;
+    [[nodiscard]] std::span<T> values();
+
+    [[nodiscard]] std::span<const int> labels() const;
+    [[nodiscard]] std::span<int> labels();
+    [[nodiscard]] int label(size_t i) const { return _labels[i]; }
+    void setLabel(size_t i, int c) { _labels[i] = c; }
+
+    [[nodiscard]] bool isView() const;
+    // view over the same values with labels of its own, for several fits of
+    // one dataset at once. valid while this dataset is; never write values through it
+    [[nodiscard]] BasicDataset share() const;
+    // made by share(), directly or as a copy. fits leave such values where they are
+    [[nodiscard]] bool isShared() const;
+
+    // append one row at the end. returns its index
+    size_t append(std::span<const T> cords);
+    void reserve(size_t rows);
+    // keeps the first `rows` rows, new rows are zero and unlabelled. never gives back capacity
+    void resize(size_t rows);
+
+    void display(size_t i) const;
+};
+
+template<typename T>
+template<typename U>
+BasicDataset<T>::BasicDataset(const BasicDataset<U>& other) : BasicDataset(other.rows(), other.dimensions()) {
+    const auto from = other.values();
+    for ( size_t i = 0; i < from.size(); ++i ) _values[i] = static_cast<T>(from[i]);
+    std::ranges::copy(other.labels(), _labels.begin());
+}
+
+using Dataset = BasicDataset<>;
+
+extern template class BasicDataset<float>;
+extern template class BasicDataset<double>;
+
+#endif // DATASET_H
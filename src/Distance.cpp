@@ -0,0 +1,566 @@
+#include "Distance.h"
+
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KMEANS_X86 1
+#endif
+
+namespace {
+
+// centers scored per call of a block kernel
+constexpr size_t BLOCK = 4;
+
+template<typename T>
+using BlockKernel = Distance::Kernels<T>::Block;
+template<typename T>
+using Accumulate = Distance::Kernels<T>::Accumulate;
+
+//-- scalar
+
+template<typename T, size_t D>
+void blockScalar(const T* x, const T* centers, const size_t count, const size_t dims, T* out) {
+    const size_t d = D ? D : dims;
+    for ( size_t c = 0; c < count; ++c ) {
+        const T* y = centers + c * d;
+        T sum = 0;
+        for ( size_t j = 0; j < d; ++j ) {
+            const T diff = x[j] - y[j];
+            sum += diff * diff;
+        }
+        out[c] = sum;
+    }
+}
+
+#ifdef KMEANS_X86
+
+//-- sse2: 2 lanes. no masked loads before avx, so dimensions past the last full vector take a scalar tail
+
+__attribute__((target("sse2")))
+inline double hsum(const __m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+template<size_t D>
+__attribute__((target("sse2")))
+void blockSSE2(const double* x, const double* centers, const size_t count, const size_t dims, double* out) {
+    const size_t d = D ? D : dims;
+    size_t c = 0;
+    for ( ; c + BLOCK <= count; c += BLOCK ) {
+        const double* y0 = centers + c * d;
+        const double* y1 = y0 + d;
+        const double* y2 = y1 + d;
+        const double* y3 = y2 + d;
+        __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd(), a2 = _mm_setzero_pd(), a3 = _mm_setzero_pd();
+
+        size_t j = 0;
+        for ( ; j + 2 <= d; j += 2 ) {
+            const __m128d xv = _mm_loadu_pd(x + j);
+            __m128d t;
+            t = _mm_sub_pd(_mm_loadu_pd(y0 + j), xv); a0 = _mm_add_pd(a0, _mm_mul_pd(t, t));
+            t = _mm_sub_pd(_mm_loadu_pd(y1 + j), xv); a1 = _mm_add_pd(a1, _mm_mul_pd(t, t));
+            t = _mm_sub_pd(_mm_loadu_pd(y2 + j), xv); a2 = _mm_add_pd(a2, _mm_mul_pd(t, t));
+            t = _mm_sub_pd(_mm_loadu_pd(y3 + j), xv); a3 = _mm_add_pd(a3, _mm_mul_pd(t, t));
+        }
+        double s0 = hsum(a0), s1 = hsum(a1), s2 = hsum(a2), s3 = hsum(a3);
+        for ( ; j < d; ++j ) {
+            const double xj = x[j];
+            s0 += (y0[j] - xj) * (y0[j] - xj);
+            s1 += (y1[j] - xj) * (y1[j] - xj);
+            s2 += (y2[j] - xj) * (y2[j] - xj);
+            s3 += (y3[j] - xj) * (y3[j] - xj);
+        }
+        out[c] = s0; out[c + 1] = s1; out[c + 2] = s2; out[c + 3] = s3;
+    }
+
+    // leftover centers one at a time, same arithmetic as the blocked path
+    for ( ; c < count; ++c ) {
+        const double* y = centers + c * d;
+        __m128d a = _mm_setzero_pd();
+        size_t j = 0;
+        for ( ; j + 2 <= d; j += 2 ) {
+            const __m128d t = _mm_sub_pd(_mm_loadu_pd(y + j), _mm_loadu_pd(x + j));
+            a = _mm_add_pd(a, _mm_mul_pd(t, t));
+        }
+        double s = hsum(a);
+        for ( ; j < d; ++j ) s += (y[j] - x[j]) * (y[j] - x[j]);
+        out[c] = s;
+    }
+}
+
+//-- avx2 + fma: 4 lanes, masked tail
+
+__attribute__((target("avx2,fma")))
+inline double hsum(const __m256d v) {
+    const __m128d lo = _mm256_castpd256_pd128(v);
+    const __m128d hi = _mm256_extractf128_pd(v, 1);
+    const __m128d s = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+template<size_t D>
+__attribute__((target("avx2,fma")))
+void blockAVX2(const double* x, const double* centers, const size_t count, const size_t dims, double* out) {
+    const size_t d = D ? D : dims;
+    const size_t rem = d % 4;
+    const __m256i mask = _mm256_setr_epi64x(rem > 0 ? -1 : 0, rem > 1 ? -1 : 0, rem > 2 ? -1 : 0, 0);
+    const size_t body = d - rem;
+
+    size_t c = 0;
+    for ( ; c + BLOCK <= count; c += BLOCK ) {
+        const double* y0 = centers + c * d;
+        const double* y1 = y0 + d;
+        const double* y2 = y1 + d;
+        const double* y3 = y2 + d;
+        __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd(), a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+
+        for ( size_t j = 0; j < body; j += 4 ) {
+            const __m256d xv = _mm256_loadu_pd(x + j);
+            __m256d t;
+            t = _mm256_sub_pd(_mm256_loadu_pd(y0 + j), xv); a0 = _mm256_fmadd_pd(t, t, a0);
+            t = _mm256_sub_pd(_mm256_loadu_pd(y1 + j), xv); a1 = _mm256_fmadd_pd(t, t, a1);
+            t = _mm256_sub_pd(_mm256_loadu_pd(y2 + j), xv); a2 = _mm256_fmadd_pd(t, t, a2);
+            t = _mm256_sub_pd(_mm256_loadu_pd(y3 + j), xv); a3 = _mm256_fmadd_pd(t, t, a3);
+        }
+        if ( rem ) {
+            const __m256d xv = _mm256_maskload_pd(x + body, mask);
+            __m256d t;
+            t = _mm256_sub_pd(_mm256_maskload_pd(y0 + body, mask), xv); a0 = _mm256_fmadd_pd(t, t, a0);
+            t = _mm256_sub_pd(_mm256_maskload_pd(y1 + body, mask), xv); a1 = _mm256_fmadd_pd(t, t, a1);
+            t = _mm256_sub_pd(_mm256_maskload_pd(y2 + body, mask), xv); a2 = _mm256_fmadd_pd(t, t, a2);
+            t = _mm256_sub_pd(_mm256_maskload_pd(y3 + body, mask), xv); a3 = _mm256_fmadd_pd(t, t, a3);
+        }
+        out[c] = hsum(a0); out[c + 1] = hsum(a1); out[c + 2] = hsum(a2); out[c + 3] = hsum(a3);
+    }
+
+    // leftover centers one at a time
+    for ( ; c < count; ++c ) {
+        const double* y = centers + c * d;
+        __m256d a = _mm256_setzero_pd();
+        for ( size_t j = 0; j < body; j += 4 ) {
+            const __m256d t = _mm256_sub_pd(_mm256_loadu_pd(y + j), _mm256_loadu_pd(x + j));
+            a = _mm256_fmadd_pd(t, t, a);
+        }
+        if ( rem ) {
+            const __m256d t = _mm256_sub_pd(_mm256_maskload_pd(y + body, mask), _mm256_maskload_pd(x + body, mask));
+            a = _mm256_fmadd_pd(t, t, a);
+        }
+        out[c] = hsum(a);
+    }
+}
+
+//-- avx-512: 8 lanes, masked tail
+
+__attribute__((target("avx512f")))
+inline double hsum(const __m512d v) {
+    const __m256d s = _mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1));
+    const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+template<size_t D>
+__attribute__((target("avx512f")))
+void blockAVX512(const double* x, const double* centers, const size_t count, const size_t dims, double* out) {
+    const size_t d = D ? D : dims;
+    const size_t rem = d % 8;
+    const __mmask8 mask = static_cast<__mmask8>((1u << rem) - 1);
+    const size_t body = d - rem;
+
+    size_t c = 0;
+    for ( ; c + BLOCK <= count; c += BLOCK ) {
+        const double* y0 = centers + c * d;
+        const double* y1 = y0 + d;
+        const double* y2 = y1 + d;
+        const double* y3 = y2 + d;
+        __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd(), a2 = _mm512_setzero_pd(), a3 = _mm512_setzero_pd();
+
+        for ( size_t j = 0; j < body; j += 8 ) {
+            const __m512d xv = _mm512_loadu_pd(x + j);
+            __m512d t;
+            t = _mm512_sub_pd(_mm512_loadu_pd(y0 + j), xv); a0 = _mm512_fmadd_pd(t, t, a0);
+            t = _mm512_sub_pd(_mm512_loadu_pd(y1 + j), xv); a1 = _mm512_fmadd_pd(t, t, a1);
+            t = _mm512_sub_pd(_mm512_loadu_pd(y2 + j), xv); a2 = _mm512_fmadd_pd(t, t, a2);
+            t = _mm512_sub_pd(_mm512_loadu_pd(y3 + j), xv); a3 = _mm512_fmadd_pd(t, t, a3);
+        }
+        if ( rem ) {
+            const __m512d xv = _mm512_maskz_loadu_pd(mask, x + body);
+            __m512d t;
+            t = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, y0 + body), xv); a0 = _mm512_fmadd_pd(t, t, a0);
+            t = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, y1 + body), xv); a1 = _mm512_fmadd_pd(t, t, a1);
+            t = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, y2 + body), xv); a2 = _mm512_fmadd_pd(t, t, a2);
+            t = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, y3 + body), xv); a3 = _mm512_fmadd_pd(t, t, a3);
+        }
+        out[c] = hsum(a0); out[c + 1] = hsum(a1); out[c + 2] = hsum(a2); out[c + 3] = hsum(a3);
+    }
+
+    for ( ; c < count; ++c ) {
+        const double* y = centers + c * d;
+        __m512d a = _mm512_setzero_pd();
+        for ( size_t j = 0; j < body; j += 8 ) {
+            const __m512d t = _mm512_sub_pd(_mm512_loadu_pd(y + j), _mm512_loadu_pd(x + j));
+            a = _mm512_fmadd_pd(t, t, a);
+        }
+        if ( rem ) {
+            const __m512d t = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, y + body), _mm512_maskz_loadu_pd(mask, x + body));
+            a = _mm512_fmadd_pd(t, t, a);
+        }
+        out[c] = hsum(a);
+    }
+}
+
+//-- single precision: twice the lanes of the kernels above, same structure
+
+__attribute__((target("sse2")))
+inline float hsum(const __m128 v) {
+    const __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+}
+
+template<size_t D>
+__attribute__((target("sse2")))
+void blockSSE2(const float* x, const float* centers, const size_t count, const size_t dims, float* out) {
+    const size_t d = D ? D : dims;
+    const size_t body = d - d % 4;
+
+    size_t c = 0;
+    for ( ; c + BLOCK <= count; c += BLOCK ) {
+        const float* y0 = centers + c * d;
+        const float* y1 = y0 + d;
+        const float* y2 = y1 + d;
+        const float* y3 = y2 + d;
+        __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps(), a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+
+        for ( size_t j = 0; j < body; j += 4 ) {
+            const __m128 xv = _mm_loadu_ps(x + j);
+            __m128 t;
+            t = _mm_sub_ps(_mm_loadu_ps(y0 + j), xv); a0 = _mm_add_ps(a0, _mm_mul_ps(t, t));
+            t = _mm_sub_ps(_mm_loadu_ps(y1 + j), xv); a1 = _mm_add_ps(a1, _mm_mul_ps(t, t));
+            t = _mm_sub_ps(_mm_loadu_ps(y2 + j), xv); a2 = _mm_add_ps(a2, _mm_mul_ps(t, t));
+            t = _mm_sub_ps(_mm_loadu_ps(y3 + j), xv); a3 = _mm_add_ps(a3, _mm_mul_ps(t, t));
+        }
+        float s0 = hsum(a0), s1 = hsum(a1), s2 = hsum(a2), s3 = hsum(a3);
+        for ( size_t j = body; j < d; ++j ) {
+            const float xj = x[j];
+            s0 += (y0[j] - xj) * (y0[j] - xj);
+            s1 += (y1[j] - xj) * (y1[j] - xj);
+            s2 += (y2[j] - xj) * (y2[j] - xj);
+            s3 += (y3[j] - xj) * (y3[j] - xj);
+        }
+        out[c] = s0; out[c + 1] = s1; out[c + 2] = s2; out[c + 3] = s3;
+    }
+
+    for ( ; c < count; ++c ) {
+        const float* y = centers + c * d;
+        __m128 a = _mm_setzero_ps();
+        for ( size_t j = 0; j < body; j += 4 ) {
+            const __m128 t = _mm_sub_ps(_mm_loadu_ps(y + j), _mm_loadu_ps(x + j));
+            a = _mm_add_ps(a, _mm_mul_ps(t, t));
+        }
+        float s = hsum(a);
+        for ( size_t j = body; j < d; ++j ) s += (y[j] - x[j]) * (y[j] - x[j]);
+        out[c] = s;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline float hsum(const __m256 v) {
+    const __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    const __m128 h = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+}
+
+template<size_t D>
+__attribute__((target("avx2,fma")))
+void blockAVX2(const float* x, const float* centers, const size_t count, const size_t dims, float* out) {
+    const size_t d = D ? D : dims;
+    const size_t rem = d % 8;
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(rem)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const size_t body = d - rem;
+
+    size_t c = 0;
+    for ( ; c + BLOCK <= count; c += BLOCK ) {
+        const float* y0 = centers + c * d;
+        const float* y1 = y0 + d;
+        const float* y2 = y1 + d;
+        const float* y3 = y2 + d;
+        __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps(), a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+
+        for ( size_t j = 0; j < body; j += 8 ) {
+            const __m256 xv = _mm256_loadu_ps(x + j);
+            __m256 t;
+            t = _mm256_sub_ps(_mm256_loadu_ps(y0 + j), xv); a0 = _mm256_fmadd_ps(t, t, a0);
+            t = _mm256_sub_ps(_mm256_loadu_ps(y1 + j), xv); a1 = _mm256_fmadd_ps(t, t, a1);
+            t = _mm256_sub_ps(_mm256_loadu_ps(y2 + j), xv); a2 = _mm256_fmadd_ps(t, t, a2);
+            t = _mm256_sub_ps(_mm256_loadu_ps(y3 + j), xv); a3 = _mm256_fmadd_ps(t, t, a3);
+        }
+        if ( rem ) {
+            const __m256 xv = _mm256_maskload_ps(x + body, mask);
+            __m256 t;
+            t = _mm256_sub_ps(_mm256_maskload_ps(y0 + body, mask), xv); a0 = _mm256_fmadd_ps(t, t, a0);
+            t = _mm256_sub_ps(_mm256_maskload_ps(y1 + body, mask), xv); a1 = _mm256_fmadd_ps(t, t, a1);
+            t = _mm256_sub_ps(_mm256_maskload_ps(y2 + body, mask), xv); a2 = _mm256_fmadd_ps(t, t, a2);
+            t = _mm256_sub_ps(_mm256_maskload_ps(y3 + body, mask), xv); a3 = _mm256_fmadd_ps(t, t, a3);
+        }
+        out[c] = hsum(a0); out[c + 1] = hsum(a1); out[c + 2] = hsum(a2); out[c + 3] = hsum(a3);
+    }
+
+    for ( ; c < count; ++c ) {
+        const float* y = centers + c * d;
+        __m256 a = _mm256_setzero_ps();
+        for ( size_t j = 0; j < body; j += 8 ) {
+            const __m256 t = _mm256_sub_ps(_mm256_loadu_ps(y + j), _mm256_loadu_ps(x + j));
+            a = _mm256_fmadd_ps(t, t, a);
+        }
+        if ( rem ) {
+            const __m256 t = _mm256_sub_ps(_mm256_maskload_ps(y + body, mask), _mm256_maskload_ps(x + body, mask));
+            a = _mm256_fmadd_ps(t, t, a);
+        }
+        out[c] = hsum(a);
+    }
+}
+
+__attribute__((target("avx512f")))
+inline float hsum(const __m512 v) {
+    // upper half through a double cast, extractf32x8 would need avx512dq
+    const __m256 upper = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+    const __m256 s = _mm256_add_ps(_mm512_castps512_ps256(v), upper);
+    const __m128 q = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+    const __m128 h = _mm_add_ps(q, _mm_movehl_ps(q, q));
+    return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+}
+
+template<size_t D>
+__attribute__((target("avx512f")))
+void blockAVX512(const float* x, const float* centers, const size_t count, const size_t dims, float* out) {
+    const size_t d = D ? D : dims;
+    const size_t rem = d % 16;
+    const __mmask16 mask = static_cast<__mmask16>((1u << rem) - 1);
+    const size_t body = d - rem;
+
+    size_t c = 0;
+    for ( ; c + BLOCK <= count; c += BLOCK ) {
+        const float* y0 = centers + c * d;
+        const float* y1 = y0 + d;
+        const float* y2 = y1 + d;
+        const float* y3 = y2 + d;
+        __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps(), a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+
+        for ( size_t j = 0; j < body; j += 16 ) {
+            const __m512 xv = _mm512_loadu_ps(x + j);
+            __m512 t;
+            t = _mm512_sub_ps(_mm512_loadu_ps(y0 + j), xv); a0 = _mm512_fmadd_ps(t, t, a0);
+            t = _mm512_sub_ps(_mm512_loadu_ps(y1 + j), xv); a1 = _mm512_fmadd_ps(t, t, a1);
+            t = _mm512_sub_ps(_mm512_loadu_ps(y2 + j), xv); a2 = _mm512_fmadd_ps(t, t, a2);
+            t = _mm512_sub_ps(_mm512_loadu_ps(y3 + j), xv); a3 = _mm512_fmadd_ps(t, t, a3);
+        }
+        if ( rem ) {
+            const __m512 xv = _mm512_maskz_loadu_ps(mask, x + body);
+            __m512 t;
+            t = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y0 + body), xv); a0 = _mm512_fmadd_ps(t, t, a0);
+            t = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y1 + body), xv); a1 = _mm512_fmadd_ps(t, t, a1);
+            t = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y2 + body), xv); a2 = _mm512_fmadd_ps(t, t, a2);
+            t = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y3 + body), xv); a3 = _mm512_fmadd_ps(t, t, a3);
+        }
+        out[c] = hsum(a0); out[c + 1] = hsum(a1); out[c + 2] = hsum(a2); out[c + 3] = hsum(a3);
+    }
+
+    for ( ; c < count; ++c ) {
+        const float* y = centers + c * d;
+        __m512 a = _mm512_setzero_ps();
+        for ( size_t j = 0; j < body; j += 16 ) {
+            const __m512 t = _mm512_sub_ps(_mm512_loadu_ps(y + j), _mm512_loadu_ps(x + j));
+            a = _mm512_fmadd_ps(t, t, a);
+        }
+        if ( rem ) {
+            const __m512 t = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y + body), _mm512_maskz_loadu_ps(mask, x + body));
+            a = _mm512_fmadd_ps(t, t, a);
+        }
+        out[c] = hsum(a);
+    }
+}
+
+#endif // KMEANS_X86
+
+// kernels compiled for exactly these dimension counts. 13 is the track feature set
+using FixedDimensions = std::index_sequence<2, 3, 4, 8, 13, 16, 32>;
+
+// D = 0 is the generic kernel for any dimension count
+template<typename T, size_t D = 0>
+BlockKernel<T> kernelFor(const Distance::Isa isa) {
+    switch ( isa ) {
+#ifdef KMEANS_X86
+        case Distance::Isa::SSE2: return blockSSE2<D>;
+        case Distance::Isa::AVX2: return blockAVX2<D>;
+        case Distance::Isa::AVX512: return blockAVX512<D>;
+#endif
+        default: return blockScalar<T, D>;
+    }
+}
+
+// nullptr unless d is one of the fixed counts
+template<typename T, size_t... D>
+BlockKernel<T> fixedKernelFor(const Distance::Isa isa, const size_t d, std::index_sequence<D...>) {
+    BlockKernel<T> kernel = nullptr;
+    static_cast<void>(( (d == D && (kernel = kernelFor<T, D>(isa))) || ... ));
+    return kernel;
+}
+
+template<typename T, size_t D>
+void accumulateRow(const T* x, double* sums, const size_t dims) {
+    const size_t d = D ? D : dims;
+    for ( size_t j = 0; j < d; ++j ) sums[j] += x[j];
+}
+
+template<typename T, size_t... D>
+Accumulate<T> accumulateFor(const size_t d, std::index_sequence<D...>) {
+    Accumulate<T> accumulate = accumulateRow<T, 0>;
+    static_cast<void>(( (d == D && (accumulate = accumulateRow<T, D>)) || ... ));
+    return accumulate;
+}
+
+Distance::Isa detect() {
+    if ( Distance::supported(Distance::Isa::AVX512) ) return Distance::Isa::AVX512;
+    if ( Distance::supported(Distance::Isa::AVX2) ) return Distance::Isa::AVX2;
+    if ( Distance::supported(Distance::Isa::SSE2) ) return Distance::Isa::SSE2;
+    return Distance::Isa::Scalar;
+}
+
+// selected once, on first use
+struct Dispatch {
+    Distance::Isa isa;
+    BlockKernel<double> block;
+    BlockKernel<float> blockFloat;
+
+    explicit Dispatch(const Distance::Isa i) : isa(i), block(kernelFor<double>(i)), blockFloat(kernelFor<float>(i)) {}
+
+    template<typename T>
+    [[nodiscard]] BlockKernel<T> kernel() const {
+        if constexpr ( std::is_same_v<T, float> ) return blockFloat;
+        else return block;
+    }
+};
+
+Dispatch& dispatch() {
+    static Dispatch current(detect());
+    return current;
+}
+
+template<typename T>
+size_t argminOf(const BlockKernel<T> block, const T* x, const T* centers, const size_t k, const size_t d, T* best) {
+    T scores[BLOCK];
+    T minDistance = std::numeric_limits<T>::infinity();
+    size_t closest = 0;
+
+    for ( size_t c = 0; c < k; c += BLOCK ) {
+        const size_t count = std::min(BLOCK, k - c);
+        block(x, centers + c * d, count, d, scores);
+
+        for ( size_t i = 0; i < count; ++i ) {
+            if ( scores[i] < minDistance ) {
+                minDistance = scores[i];
+                closest = c + i;
+            }
+        }
+    }
+
+    if ( best ) *best = minDistance;
+    return closest;
+}
+
+} // namespace
+
+bool Distance::supported(const Isa isa) {
+    switch ( isa ) {
+        case Isa::Scalar: return true;
+#ifdef KMEANS_X86
+        case Isa::SSE2: return __builtin_cpu_supports("sse2");
+        case Isa::AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Isa::AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+        default: return false;
+    }
+}
+
+Distance::Isa Distance::isa() { return dispatch().isa; }
+
+void Distance::setIsa(const Isa isa) {
+    if ( !supported(isa) ) {
+        throw std::invalid_argument(std::format("[ERROR] Instruction set {} is not supported by this cpu.", name(isa)));
+    }
+    dispatch() = Dispatch(isa);
+}
+
+const char* Distance::name(const Isa isa) {
+    switch ( isa ) {
+        case Isa::SSE2: return "sse2";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+double Distance::squaredL2(const double* a, const double* b, const size_t d) {
+    double out;
+    dispatch().block(a, b, 1, d, &out);
+    return out;
+}
+
+double Distance::squaredL2(const std::span<const double> a, const std::span<const double> b) {
+    return squaredL2(a.data(), b.data(), a.size());
+}
+
+void Distance::squaredL2Block(const double* x, const double* centers, const size_t count, const size_t d, double* out) {
+    dispatch().block(x, centers, count, d, out);
+}
+
+size_t Distance::argmin(const double* x, const double* centers, const size_t k, const size_t d, double* best) {
+    return argminOf(dispatch().kernel<double>(), x, centers, k, d, best);
+}
+
+float Distance::squaredL2(const float* a, const float* b, const size_t d) {
+    float out;
+    dispatch().blockFloat(a, b, 1, d, &out);
+    return out;
+}
+
+float Distance::squaredL2(const std::span<const float> a, const std::span<const float> b) {
+    return squaredL2(a.data(), b.data(), a.size());
+}
+
+void Distance::squaredL2Block(const float* x, const float* centers, const size_t count, const size_t d, float* out) {
+    dispatch().blockFloat(x, centers, count, d, out);
+}
+
+size_t Distance::argmin(const float* x, const float* centers, const size_t k, const size_t d, float* best) {
+    return argminOf(dispatch().kernel<float>(), x, centers, k, d, best);
+}
+
+//-- kernels bound to one dimension count
+
+template<typename T>
+Distance::Kernels<T> Distance::kernels(const size_t d) {
+    const Isa current = isa();
+    Kernels<T> bound;
+    bound._dimensions = d;
+    bound._block = fixedKernelFor<T>(current, d, FixedDimensions{});
+    bound._fixed = bound._block != nullptr;
+    if ( !bound._fixed ) bound._block = kernelFor<T>(current);
+    bound._accumulate = accumulateFor<T>(d, FixedDimensions{});
+    return bound;
+}
+
+template<typename T>
+size_t Distance::Kernels<T>::argmin(const T* x, const T* centers, const size_t k, T* best) const {
+    return argminOf(_block, x, centers, k, _dimensions, best);
+}
+
+template class Distance::Kernels<float>;
+template class Distance::Kernels<double>;
+template Distance::Kernels<float> Distance::kernels(size_t);
+template Distance::Kernels<double> Distance::kernels(size_t);
@@ -0,0 +1,85 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <cstddef>
+#include <span>
+
+/*
+ * squared euclidean distance kernels.
+ * assignment only needs the argmin, so no sqrt is taken here.
+ * the instruction set is picked once at runtime from what the cpu supports.
+ * float overloads work in single precision with twice the lanes per register.
+ */
+class Distance {
+public:
+    enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+    /*
+     * kernels bound to one dimension count, picked once per dataset.
+     * common counts get kernels compiled for exactly that size, so the
+     * dimension loops are unrolled and a block of centers is scored in
+     * registers. other counts use the generic kernels. results are the same
+     * either way. uses the instruction set selected when they are made.
+     */
+    template<typename T>
+    class Kernels {
+    public:
+        using Block = void (*)(const T* x, const T* centers, size_t count, size_t d, T* out);
+        using Accumulate = void (*)(const T* x, double* sums, size_t d);
+
+        Kernels() = default;
+
+        [[nodiscard]] T squaredL2(const T* a, const T* b) const {
+            T out;
+            _block(a, b, 1, _dimensions, &out);
+            return out;
+        }
+        void squaredL2Block(const T* x, const T* centers, const size_t count, T* out) const {
+            _block(x, centers, count, _dimensions, out);
+        }
+        [[nodiscard]] size_t argmin(const T* x, const T* centers, size_t k, T* best = nullptr) const;
+        // sums[j] += x[j] for every dimension
+        void accumulate(const T* x, double* sums) const { _accumulate(x, sums, _dimensions); }
+
+        [[nodiscard]] size_t dimensions() const { return _dimensions; }
+        // true if d has its own kernels
+        [[nodiscard]] bool fixed() const { return _fixed; }
+
+    private:
+        friend class Distance;
+        size_t _dimensions = 0;
+        Block _block = nullptr;
+        Accumulate _accumulate = nullptr;
+        bool _fixed = false;
+    };
+
+    template<typename T>
+    [[nodiscard]] static Kernels<T> kernels(size_t d);
+
+    // squared distance between two vectors of size d
+    [[nodiscard]] static double squaredL2(const double* a, const double* b, size_t d);
+    [[nodiscard]] static double squaredL2(std::span<const double> a, std::span<const double> b);
+
+    // scores one point against `count` row-major centers, out[c] = ||x - centers[c]||^2
+    static void squaredL2Block(const double* x, const double* centers, size_t count, size_t d, double* out);
+
+    // index of the closest of k row-major centers. first one wins on ties.
+    [[nodiscard]] static size_t argmin(const double* x, const double* centers, size_t k, size_t d, double* best = nullptr);
+
+    // single precision versions of the above
+    [[nodiscard]] static float squaredL2(const float* a, const float* b, size_t d);
+    [[nodiscard]] static float squaredL2(std::span<const float> a, std::span<const float> b);
+    static void squaredL2Block(const float* x, const float* centers, size_t count, size_t d, float* out);
+    [[nodiscard]] static size_t argmin(const float* x, const float* centers, size_t k, size_t d, float* best = nullptr);
+
+    // dispatch control. setIsa is meant for benchmarks, call it before fitting
+    [[nodiscard]] static Isa isa();
+    [[nodiscard]] static bool supported(Isa isa);
+    static void setIsa(Isa isa);    // throws if the cpu does not support it
+    [[nodiscard]] static const char* name(Isa isa);
+};
+
+extern template class Distance::Kernels<float>;
+extern template class Distance::Kernels<double>;
+
+#endif // DISTANCE_H
@@ -0,0 +1,214 @@
+#include "FeatureCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "Hash.h"
+
+namespace {
+
+// piece of the source hashed by one task
+constexpr size_t HASH_CHUNK_BYTES = 1 << 20;
+constexpr size_t FEATURE_ALIGNMENT = 64;
+
+struct Stamp {
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+Stamp stampOf(const std::string& path) {
+    struct stat info{};
+    if ( ::stat(path.c_str(), &info) != 0 ) throw std::runtime_error(std::format("[ERROR] Could not stat file: {}", path));
+    return {static_cast<uint64_t>(info.st_size),
+            static_cast<int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec};
+}
+
+size_t alignUp(const size_t offset, const size_t alignment) { return (offset + alignment - 1) / alignment * alignment; }
+
+//-- names block
+void writeNames(std::ostream& out, const std::vector<std::string>& names) {
+    for ( const auto& name : names ) {
+        const auto length = static_cast<uint32_t>(name.size());
+        out.write(reinterpret_cast<const char*>(&length), sizeof length);
+        out.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+}
+
+size_t namesSize(const std::vector<std::string>& names) {
+    size_t size = 0;
+    for ( const auto& name : names ) size += sizeof(uint32_t) + name.size();
+    return size;
+}
+
+// reads `count` names from [p, end). false if the block is cut short
+bool readNames(const char*& p, const char* end, const size_t count, std::vector<std::string>& names) {
+    names.clear();
+    for ( size_t i = 0; i < count; ++i ) {
+        uint32_t length;
+        if ( end - p < static_cast<std::ptrdiff_t>(sizeof length) ) return false;
+        std::memcpy(&length, p, sizeof length);
+        p += sizeof length;
+        if ( end - p < static_cast<std::ptrdiff_t>(length) ) return false;
+        names.emplace_back(p, length);
+        p += length;
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t FeatureCache::hashFile(const MappedFile& file, ThreadPool& pool) {
+    const size_t chunks = (file.size() + HASH_CHUNK_BYTES - 1) / HASH_CHUNK_BYTES;
+
+    // chunk hashes combined in file order, so the result does not depend on the pool
+    return pool.parallelReduce(size_t{0}, chunks, 1, hashBytes(reinterpret_cast<const char*>(&chunks), sizeof chunks),
+        [&file](const size_t c, size_t) {
+            const size_t from = c * HASH_CHUNK_BYTES;
+            return hashBytes(file.data() + from, std::min(HASH_CHUNK_BYTES, file.size() - from));
+        },
+        [](const uint64_t h, const uint64_t chunk) {
+            return hashBytes(reinterpret_cast<const char*>(&chunk), sizeof chunk, h);
+        });
+}
+
+void FeatureCache::write(const std::string& source, const std::string& cache_path, ThreadPool& pool,
+                         const CsvTable& table, const Scaler& scaler, const int limit) {
+    const MappedFile csv(source);
+    const Stamp stamp = stampOf(source);
+    const Dataset& features = table.features();
+
+    std::vector<std::string> names = table.header();
+    names.insert(names.end(), table.numericFields().begin(), table.numericFields().end());
+    names.insert(names.end(), table.textFields().begin(), table.textFields().end());
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.version = VERSION;
+    header.scalar_bytes = sizeof(double);
+    header.rows = features.rows();
+    header.dimensions = features.dimensions();
+    header.scaling = static_cast<uint64_t>(scaler.scaling);
+    header.header_fields = table.header().size();
+    header.text_fields = table.textFields().size();
+    header.limit = limit;
+    header.source_size = stamp.size;
+    header.source_mtime_ns = stamp.mtime_ns;
+    header.source_hash = hashFile(csv, pool);
+    header.names_offset = sizeof(Header);
+    header.scaler_offset = alignUp(header.names_offset + namesSize(names), alignof(double));
+    header.text_offset = header.scaler_offset + 2 * header.dimensions * sizeof(double);
+    header.features_offset = alignUp(header.text_offset + table._text.size() * sizeof(CsvTable::TextRef), FEATURE_ALIGNMENT);
+    header.file_size = header.features_offset + features.values().size_bytes();
+
+    if ( scaler.center.size() != header.dimensions || scaler.spread.size() != header.dimensions ) {
+        throw std::invalid_argument("[ERROR] Scaler does not match the features.");
+    }
+
+    const std::string temporary = cache_path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if ( !out.is_open() ) throw std::runtime_error(std::format("[ERROR] Could not create file: {}", temporary));
+
+        const auto pad = [&out](const uint64_t offset) {
+            const auto at = static_cast<uint64_t>(out.tellp());
+            for ( uint64_t i = at; i < offset; ++i ) out.put('\0');
+        };
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof header);
+        writeNames(out, names);
+        pad(header.scaler_offset);
+        out.write(reinterpret_cast<const char*>(scaler.center.data()), static_cast<std::streamsize>(header.dimensions * sizeof(double)));
+        out.write(reinterpret_cast<const char*>(scaler.spread.data()), static_cast<std::streamsize>(header.dimensions * sizeof(double)));
+        out.write(reinterpret_cast<const char*>(table._text.data()),
+                  static_cast<std::streamsize>(table._text.size() * sizeof(CsvTable::TextRef)));
+        pad(header.features_offset);
+        out.write(reinterpret_cast<const char*>(features.values().data()), static_cast<std::streamsize>(features.values().size_bytes()));
+
+        if ( !out ) throw std::runtime_error(std::format("[ERROR] Could not write file: {}", temporary));
+    }
+
+    // readers see either the old cache or the complete new one
+    std::filesystem::rename(temporary, cache_path);
+}
+
+FeatureCache::Loaded FeatureCache::load(const std::string& source, const std::string& cache_path, ThreadPool& pool,
+                                        const std::vector<std::string>& text_fields, const int limit,
+                                        const Scaling scaling) {
+    const Stamp stamp = stampOf(source);
+
+    //-- try the cache. any mismatch falls through to a rebuild
+    auto cached = [&]() -> std::optional<Loaded> {
+        if ( !std::filesystem::exists(cache_path) ) return std::nullopt;
+
+        // private writable mapping: the features can be changed in memory without touching the cache
+        auto mapped = std::make_shared<MappedFile>(cache_path, true);
+        if ( mapped->size() < sizeof(Header) ) return std::nullopt;
+
+        Header header;
+        std::memcpy(&header, mapped->data(), sizeof header);
+        if ( std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 || header.version != VERSION ) return std::nullopt;
+        if ( header.scalar_bytes != sizeof(double) || header.file_size != mapped->size() ) return std::nullopt;
+        if ( header.limit != limit || header.source_size != stamp.size ) return std::nullopt;
+        if ( header.text_fields != text_fields.size() || header.dimensions == 0 ) return std::nullopt;
+        if ( header.scaling != static_cast<uint64_t>(scaling) ) return std::nullopt;
+
+        // sections in order and inside the file, sized by dims and rows; divisions keep it from overflowing
+        const auto fits = [](const uint64_t offset, const uint64_t count, const uint64_t bytes, const uint64_t limit) {
+            return offset <= limit && count <= (limit - offset) / bytes;
+        };
+        if ( header.names_offset < sizeof(Header) || header.names_offset > header.scaler_offset ) return std::nullopt;
+        if ( !fits(header.scaler_offset, header.dimensions, 2 * sizeof(double), header.text_offset) ) return std::nullopt;
+        if ( header.text_fields > 0 &&
+             !fits(header.text_offset, header.rows, header.text_fields * sizeof(CsvTable::TextRef), header.features_offset) ) return std::nullopt;
+        if ( header.features_offset > header.file_size ) return std::nullopt;
+        const uint64_t feature_bytes = header.file_size - header.features_offset;
+        if ( feature_bytes % (header.dimensions * sizeof(double)) != 0 ||
+             feature_bytes / (header.dimensions * sizeof(double)) != header.rows ) return std::nullopt;
+
+        auto csv = std::make_shared<const MappedFile>(source);
+
+        // same size but touched: only the contents count
+        if ( header.source_mtime_ns != stamp.mtime_ns && header.source_hash != hashFile(*csv, pool) ) return std::nullopt;
+
+        const char* const end = mapped->data() + mapped->size();
+        const char* p = mapped->data() + header.names_offset;
+
+        Loaded loaded{CsvTable{}, {}, false};
+        CsvTable& table = loaded.table;
+        if ( !readNames(p, end, header.header_fields, table._header) ) return std::nullopt;
+        if ( !readNames(p, end, header.dimensions, table._numeric_fields) ) return std::nullopt;
+        if ( !readNames(p, end, header.text_fields, table._text_fields) ) return std::nullopt;
+        if ( table._text_fields != text_fields ) return std::nullopt;
+        if ( p > mapped->data() + header.scaler_offset ) return std::nullopt;
+
+        const auto* scaler = reinterpret_cast<const double*>(mapped->data() + header.scaler_offset);
+        loaded.scaler.scaling = scaling;
+        loaded.scaler.center.assign(scaler, scaler + header.dimensions);
+        loaded.scaler.spread.assign(scaler + header.dimensions, scaler + 2 * header.dimensions);
+
+        const auto* refs = reinterpret_cast<const CsvTable::TextRef*>(mapped->data() + header.text_offset);
+        table._text.assign(refs, refs + header.rows * header.text_fields);
+        table._file = std::move(csv);
+
+        auto* values = reinterpret_cast<double*>(mapped->mutableData() + header.features_offset);
+        table._features = Dataset(values, header.rows, header.dimensions, std::move(mapped));
+        return loaded;
+    }();
+    if ( cached ) return std::move(*cached);
+
+    //-- rebuild from the csv
+    Loaded loaded{CsvReader::read(source, pool, text_fields, limit), {}, true};
+    Dataset& features = loaded.table.features();
+    if ( !features.empty() ) {
+        loaded.scaler = Scaler::fit(features, scaling, pool);
+        loaded.scaler.transform(features, pool);
+    }
+    write(source, cache_path, pool, loaded.table, loaded.scaler, limit);
+    return loaded;
+}
@@ -0,0 +1,73 @@
+#ifndef FEATURECACHE_H
+#define FEATURECACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CsvReader.h"
+#include "Scaler.h"
+#include "ThreadPool.h"
+
+/*
+ * binary cache of a parsed and scaled csv file.
+ *
+ * layout, all integers little endian:
+ *   Header
+ *   names       header, numeric and text field names, each u32 length + bytes
+ *   scaler      dims Scaler::center values, then dims Scaler::spread values
+ *   text refs   rows x text fields CsvTable::TextRef, offsets into the csv
+ *   features    rows x dims scaled values, row-major, 64 byte aligned
+ *
+ * the cache remembers size, modification time and a hash of the csv it was
+ * built from. a valid cache is mapped, not read: the features are used in place.
+ */
+class FeatureCache {
+public:
+    static constexpr char MAGIC[8] = {'K', 'M', 'C', 'A', 'C', 'H', 'E', '\0'};
+    static constexpr uint32_t VERSION = 2;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t scalar_bytes;          // sizeof the stored feature type
+        uint64_t rows;
+        uint64_t dimensions;
+        uint64_t scaling;               // Scaling of the features
+        uint64_t header_fields;
+        uint64_t text_fields;
+        int64_t limit;                  // row limit the csv was read with
+        uint64_t source_size;
+        int64_t source_mtime_ns;
+        uint64_t source_hash;
+        uint64_t names_offset;
+        uint64_t scaler_offset;
+        uint64_t text_offset;
+        uint64_t features_offset;
+        uint64_t file_size;
+    };
+
+    struct Loaded {
+        CsvTable table;                 // features already scaled
+        Scaler scaler;                  // what the features were scaled with, for points given to predict later
+        bool rebuilt;                   // false if the cache was used as is
+    };
+
+    /*
+     * table of `source` with scaled features. uses `cache_path` when it
+     * matches the source, the requested text fields and the scaling,
+     * otherwise parses the csv again and rewrites the cache.
+     */
+    [[nodiscard]] static Loaded load(const std::string& source, const std::string& cache_path, ThreadPool& pool,
+                                     const std::vector<std::string>& text_fields, int limit = -1,
+                                     Scaling scaling = Scaling::MinMax);
+
+    // writes `table` and its scaler to `cache_path`, through a temporary file
+    static void write(const std::string& source, const std::string& cache_path, ThreadPool& pool,
+                      const CsvTable& table, const Scaler& scaler, int limit = -1);
+
+    // 64 bit hash of the whole file, chunks are hashed in parallel
+    [[nodiscard]] static uint64_t hashFile(const MappedFile& file, ThreadPool& pool);
+};
+
+#endif // FEATURECACHE_H
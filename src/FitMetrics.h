@@ -0,0 +1,58 @@
+#ifndef FITMETRICS_H
+#define FITMETRICS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/*
+ * what one iteration of a full batch fit did, handed to the observer set with
+ * Kmeans::observe. times are milliseconds; points in time count from the start
+ * of the fit, so iterations and workers line up on one timeline.
+ */
+struct IterationMetrics {
+    // one arena slot: a pool worker, or the calling thread as the last slot
+    struct Worker {
+        size_t rows = 0;                // points it assigned and accumulated
+        size_t chunks = 0;
+        double busy_ms = 0.0;           // time inside its chunks
+        double first_ms = 0.0;          // start of its first chunk
+        double last_ms = 0.0;           // end of its last chunk
+    };
+
+    int iteration = 0;
+    double start_ms = 0.0;
+    double assign_ms = 0.0;             // fused assignment and accumulation over all points
+    double merge_ms = 0.0;              // reduction of the per thread sums
+    double update_ms = 0.0;             // new centers from the sums
+    double reduce_ms = 0.0;             // distributed fits: the all-reduce between ranks
+
+    size_t changed = 0;                 // points whose label changed
+    size_t computed = 0;                // distances evaluated
+    double inertia = 0.0;               // sum of squared distances to the centers the points were assigned to
+    double max_shift = 0.0;             // largest distance a center moved
+    double total_shift = 0.0;           // sum of the distances all centers moved
+    size_t reseeded = 0;                // empty clusters moved onto far points, see KmeansConfig::reseed_empty
+
+    std::vector<Worker> workers;
+
+    [[nodiscard]] double totalMs() const { return assign_ms + merge_ms + update_ms + reduce_ms; }
+
+    // busiest worker against the mean of the workers that got any rows, 1 when perfectly balanced
+    [[nodiscard]] double imbalance() const {
+        double busiest = 0.0, sum = 0.0;
+        size_t active = 0;
+        for ( const auto& worker : workers ) {
+            if ( worker.chunks == 0 ) continue;
+            busiest = std::max(busiest, worker.busy_ms);
+            sum += worker.busy_ms;
+            ++active;
+        }
+        return sum > 0.0 ? busiest * static_cast<double>(active) / sum : 1.0;
+    }
+};
+
+using IterationObserver = std::function<void(const IterationMetrics&)>;
+
+#endif // FITMETRICS_H
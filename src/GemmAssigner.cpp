@@ -0,0 +1,270 @@
+#include "GemmAssigner.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Distance.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KMEANS_X86 1
+#endif
+
+namespace {
+
+constexpr size_t MR = GemmAssigner<double>::MR;
+constexpr size_t NR = GemmAssigner<double>::NR;
+static_assert(MR == GemmAssigner<float>::MR && NR == GemmAssigner<float>::NR);
+
+/*
+ * c[r * ldc + n] += sum over p of a[p * MR + r] * b[p * NR + n]
+ * a is an MR wide packed panel of points, b an NR wide packed panel of centers.
+ */
+template<typename T>
+void kernelScalar(const size_t kc, const T* a, const T* b, T* c, const size_t ldc) {
+    T acc[MR][NR] = {};
+    for ( size_t p = 0; p < kc; ++p ) {
+        for ( size_t r = 0; r < MR; ++r ) {
+            const T ar = a[p * MR + r];
+            for ( size_t n = 0; n < NR; ++n ) acc[r][n] += ar * b[p * NR + n];
+        }
+    }
+    for ( size_t r = 0; r < MR; ++r ) {
+        for ( size_t n = 0; n < NR; ++n ) c[r * ldc + n] += acc[r][n];
+    }
+}
+
+#ifdef KMEANS_X86
+
+// 4 x 8 tile in 8 ymm accumulators, one broadcast per point
+__attribute__((target("avx2,fma")))
+void kernelAVX2(const size_t kc, const double* a, const double* b, double* c, const size_t ldc) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+
+    for ( size_t p = 0; p < kc; ++p ) {
+        const __m256d b0 = _mm256_load_pd(b + p * NR);
+        const __m256d b1 = _mm256_load_pd(b + p * NR + 4);
+        __m256d ar;
+        ar = _mm256_broadcast_sd(a + p * MR);     c00 = _mm256_fmadd_pd(ar, b0, c00); c01 = _mm256_fmadd_pd(ar, b1, c01);
+        ar = _mm256_broadcast_sd(a + p * MR + 1); c10 = _mm256_fmadd_pd(ar, b0, c10); c11 = _mm256_fmadd_pd(ar, b1, c11);
+        ar = _mm256_broadcast_sd(a + p * MR + 2); c20 = _mm256_fmadd_pd(ar, b0, c20); c21 = _mm256_fmadd_pd(ar, b1, c21);
+        ar = _mm256_broadcast_sd(a + p * MR + 3); c30 = _mm256_fmadd_pd(ar, b0, c30); c31 = _mm256_fmadd_pd(ar, b1, c31);
+    }
+
+    double* r0 = c;
+    double* r1 = c + ldc;
+    double* r2 = c + 2 * ldc;
+    double* r3 = c + 3 * ldc;
+    _mm256_storeu_pd(r0, _mm256_add_pd(_mm256_loadu_pd(r0), c00)); _mm256_storeu_pd(r0 + 4, _mm256_add_pd(_mm256_loadu_pd(r0 + 4), c01));
+    _mm256_storeu_pd(r1, _mm256_add_pd(_mm256_loadu_pd(r1), c10)); _mm256_storeu_pd(r1 + 4, _mm256_add_pd(_mm256_loadu_pd(r1 + 4), c11));
+    _mm256_storeu_pd(r2, _mm256_add_pd(_mm256_loadu_pd(r2), c20)); _mm256_storeu_pd(r2 + 4, _mm256_add_pd(_mm256_loadu_pd(r2 + 4), c21));
+    _mm256_storeu_pd(r3, _mm256_add_pd(_mm256_loadu_pd(r3), c30)); _mm256_storeu_pd(r3 + 4, _mm256_add_pd(_mm256_loadu_pd(r3 + 4), c31));
+}
+
+// 4 x 8 tile in 4 zmm accumulators
+__attribute__((target("avx512f")))
+void kernelAVX512(const size_t kc, const double* a, const double* b, double* c, const size_t ldc) {
+    __m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+    __m512d c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+
+    for ( size_t p = 0; p < kc; ++p ) {
+        const __m512d bv = _mm512_load_pd(b + p * NR);
+        c0 = _mm512_fmadd_pd(_mm512_set1_pd(a[p * MR]), bv, c0);
+        c1 = _mm512_fmadd_pd(_mm512_set1_pd(a[p * MR + 1]), bv, c1);
+        c2 = _mm512_fmadd_pd(_mm512_set1_pd(a[p * MR + 2]), bv, c2);
+        c3 = _mm512_fmadd_pd(_mm512_set1_pd(a[p * MR + 3]), bv, c3);
+    }
+
+    _mm512_storeu_pd(c, _mm512_add_pd(_mm512_loadu_pd(c), c0));
+    _mm512_storeu_pd(c + ldc, _mm512_add_pd(_mm512_loadu_pd(c + ldc), c1));
+    _mm512_storeu_pd(c + 2 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 2 * ldc), c2));
+    _mm512_storeu_pd(c + 3 * ldc, _mm512_add_pd(_mm512_loadu_pd(c + 3 * ldc), c3));
+}
+
+// single precision 4 x 8 tile, one ymm accumulator per point.
+// also used on avx-512 cpus: a 16 lane register would need NR = 16
+__attribute__((target("avx2,fma")))
+void kernelAVX2(const size_t kc, const float* a, const float* b, float* c, const size_t ldc) {
+    __m256 c0 = _mm256_setzero_ps(), c1 = _mm256_setzero_ps();
+    __m256 c2 = _mm256_setzero_ps(), c3 = _mm256_setzero_ps();
+
+    for ( size_t p = 0; p < kc; ++p ) {
+        const __m256 bv = _mm256_load_ps(b + p * NR);
+        c0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + p * MR), bv, c0);
+        c1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + p * MR + 1), bv, c1);
+        c2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + p * MR + 2), bv, c2);
+        c3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + p * MR + 3), bv, c3);
+    }
+
+    _mm256_storeu_ps(c, _mm256_add_ps(_mm256_loadu_ps(c), c0));
+    _mm256_storeu_ps(c + ldc, _mm256_add_ps(_mm256_loadu_ps(c + ldc), c1));
+    _mm256_storeu_ps(c + 2 * ldc, _mm256_add_ps(_mm256_loadu_ps(c + 2 * ldc), c2));
+    _mm256_storeu_ps(c + 3 * ldc, _mm256_add_ps(_mm256_loadu_ps(c + 3 * ldc), c3));
+}
+
+#endif // KMEANS_X86
+
+template<typename T>
+typename GemmAssigner<T>::MicroKernel kernelFor(const Distance::Isa isa) {
+    switch ( isa ) {
+#ifdef KMEANS_X86
+        case Distance::Isa::AVX2:
+            return kernelAVX2;
+        case Distance::Isa::AVX512:
+            if constexpr ( std::is_same_v<T, float> ) return kernelAVX2;
+            else return kernelAVX512;
+#endif
+        default: return kernelScalar<T>;
+    }
+}
+
+} // namespace
+
+template<typename T>
+GemmAssigner<T>::GemmAssigner(const size_t k, const size_t dimensions) :
+                _k(k),
+                _dimensions(dimensions),
+                _panels((k + NR - 1) / NR),
+                _packed(_panels * NR * dimensions, T{0}),
+                _norms(_panels * NR, std::numeric_limits<T>::infinity()),
+                _kernel(kernelFor<T>(Distance::isa()))
+{
+    if ( k == 0 || dimensions == 0 ) throw std::invalid_argument("[ERROR] GemmAssigner needs k and dimensions to be positive.");
+}
+
+template<typename T>
+void GemmAssigner<T>::setCenters(const T* centers) {
+    _maxNorm = 0;
+    for ( size_t c = 0; c < _k; ++c ) {
+        const T* center = centers + c * _dimensions;
+        T* panel = _packed.data() + (c / NR) * NR * _dimensions;
+        const size_t lane = c % NR;
+
+        // a center that did not move keeps its packed column and norm; the norm is +inf until first packed
+        size_t same = 0;
+        if ( _norms[c] != std::numeric_limits<T>::infinity() ) {
+            while ( same < _dimensions && panel[same * NR + lane] == center[same] ) ++same;
+        }
+        if ( same == _dimensions ) {
+            _maxNorm = std::max(_maxNorm, _norms[c]);
+            continue;
+        }
+
+        T norm = 0;
+        for ( size_t j = 0; j < _dimensions; ++j ) {
+            panel[j * NR + lane] = center[j];
+            norm += center[j] * center[j];
+        }
+        _norms[c] = norm;
+        _maxNorm = std::max(_maxNorm, norm);
+    }
+}
+
+template<typename T>
+T GemmAssigner<T>::tieMargin(const T* x) const {
+    /*
+     * every score ||c||^2 - 2 x.c is off by at most about d * eps * (||x||^2 + ||c||^2),
+     * as |2 x.c| <= ||x||^2 + ||c||^2. two scores, plus the direct scan's own
+     * rounding of the distances, stay well inside four times that.
+     */
+    T norm = 0;
+    for ( size_t j = 0; j < _dimensions; ++j ) norm += x[j] * x[j];
+    return T{4} * static_cast<T>(_dimensions) * std::numeric_limits<T>::epsilon() * (norm + _maxNorm);
+}
+
+template<typename T>
+size_t GemmAssigner<T>::assign(const T* points, const size_t rows, int* labels, T* gaps) const {
+    const size_t d = _dimensions;
+    const size_t ldc = NC;
+
+    // per thread scratch: packed point panels and one tile of products, kept between calls
+    thread_local AlignedVector<T> packedA;
+    thread_local AlignedVector<T> tile;
+    if ( packedA.size() < MC * d ) packedA.resize(MC * d);
+    if ( tile.size() < MC * NC ) tile.resize(MC * NC);
+    T bestScore[MC];
+    T secondScore[MC];
+    int bestCenter[MC];
+
+    size_t changed = 0;
+
+    for ( size_t i0 = 0; i0 < rows; i0 += MC ) {
+        const size_t mc = std::min(MC, rows - i0);
+        const size_t rowPanels = (mc + MR - 1) / MR;
+
+        //-- pack MR wide panels of points, zero padded
+        for ( size_t rp = 0; rp < rowPanels; ++rp ) {
+            T* panel = packedA.data() + rp * MR * d;
+            for ( size_t r = 0; r < MR; ++r ) {
+                const size_t i = rp * MR + r;
+                const T* x = points + (i0 + i) * d;
+                for ( size_t j = 0; j < d; ++j ) panel[j * MR + r] = i < mc ? x[j] : T{0};
+            }
+        }
+
+        std::fill_n(bestScore, mc, std::numeric_limits<T>::infinity());
+        std::fill_n(secondScore, mc, std::numeric_limits<T>::infinity());
+        std::fill_n(bestCenter, mc, 0);
+
+        for ( size_t n0 = 0; n0 < _panels * NR; n0 += NC ) {
+            const size_t nc = std::min(NC, _panels * NR - n0);
+            std::fill_n(tile.data(), MC * NC, T{0});
+
+            //-- tile = points x centers^T, KC dimensions at a time
+            for ( size_t k0 = 0; k0 < d; k0 += KC ) {
+                const size_t kc = std::min(KC, d - k0);
+
+                for ( size_t cp = 0; cp < nc / NR; ++cp ) {
+                    const T* b = _packed.data() + ((n0 / NR) + cp) * NR * d + k0 * NR;
+                    for ( size_t rp = 0; rp < rowPanels; ++rp ) {
+                        const T* a = packedA.data() + rp * MR * d + k0 * MR;
+                        _kernel(kc, a, b, tile.data() + rp * MR * ldc + cp * NR, ldc);
+                    }
+                }
+            }
+
+            //-- row-wise argmin of ||c||^2 - 2 x.c, and the runner-up when asked for
+            for ( size_t i = 0; i < mc; ++i ) {
+                const T* products = tile.data() + i * ldc;
+                if ( !gaps ) {
+                    for ( size_t n = 0; n < nc; ++n ) {
+                        if ( const T score = _norms[n0 + n] - T{2} * products[n]; score < bestScore[i] ) {
+                            bestScore[i] = score;
+                            bestCenter[i] = static_cast<int>(n0 + n);
+                        }
+                    }
+                    continue;
+                }
+                for ( size_t n = 0; n < nc; ++n ) {
+                    const T score = _norms[n0 + n] - T{2} * products[n];
+                    if ( score < bestScore[i] ) {
+                        secondScore[i] = bestScore[i];
+                        bestScore[i] = score;
+                        bestCenter[i] = static_cast<int>(n0 + n);
+                    }
+                    else if ( score < secondScore[i] ) {
+                        secondScore[i] = score;
+                    }
+                }
+            }
+        }
+
+        for ( size_t i = 0; i < mc; ++i ) {
+            if ( gaps ) gaps[i0 + i] = secondScore[i] - bestScore[i];
+            if ( labels[i0 + i] != bestCenter[i] ) {
+                labels[i0 + i] = bestCenter[i];
+                ++changed;
+            }
+        }
+    }
+
+    return changed;
+}
+
+template class GemmAssigner<float>;
+template class GemmAssigner<double>;
@@ -0,0 +1,58 @@
+#ifndef GEMMASSIGNER_H
+#define GEMMASSIGNER_H
+
+#include <cstddef>
+
+#include "AlignedAllocator.h"
+
+/*
+ * batched assignment for large k * d.
+ * ||x - c||^2 = ||x||^2 - 2 x.c + ||c||^2, and ||x||^2 does not change the argmin,
+ * so each row only needs min over c of (||c||^2 - 2 x.c).
+ * the x.c products are computed as a tiled matrix product points x centers^T
+ * with a register-blocked micro-kernel over packed panels.
+ * T is the scalar of points and centers, float or double.
+ */
+template<typename T>
+class GemmAssigner {
+public:
+    // micro-kernel shape: MR points x NR centers held in registers
+    static constexpr size_t MR = 4;
+    static constexpr size_t NR = 8;
+
+    // cache tiles: MC points and NC centers per block, KC dimensions per pass
+    static constexpr size_t MC = 64;
+    static constexpr size_t NC = 128;
+    static constexpr size_t KC = 256;
+
+    GemmAssigner(size_t k, size_t dimensions);
+
+    // packs the centers into NR wide panels and precomputes their norms.
+    // call after every center update, before assign. unmoved centers are not packed again
+    void setCenters(const T* centers);
+
+    // assigns `rows` row-major points. labels are updated in place and the
+    // number of changed labels is returned. safe to call from several threads.
+    // `gaps`, when set, receives per row how far the runner-up scored behind the winner
+    size_t assign(const T* points, size_t rows, int* labels, T* gaps = nullptr) const;
+
+    // gap below which rounding in the product, or in a direct scan, could pick
+    // another winner for `x`. such rows need the exact scan to decide
+    [[nodiscard]] T tieMargin(const T* x) const;
+
+    using MicroKernel = void (*)(size_t kc, const T* a, const T* b, T* c, size_t ldc);
+
+private:
+    size_t _k;
+    size_t _dimensions;
+    size_t _panels;                     // ceil(k / NR)
+    AlignedVector<T> _packed;           // panel p: dimensions x NR, zero padded
+    AlignedVector<T> _norms;            // ||c||^2, +inf for padding centers
+    T _maxNorm = 0;                     // largest ||c||^2
+    MicroKernel _kernel;
+};
+
+extern template class GemmAssigner<float>;
+extern template class GemmAssigner<double>;
+
+#endif // GEMMASSIGNER_H
@@ -0,0 +1,24 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// fnv-1a over 8 byte words, tail bytes one at a time. fast, not cryptographic
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+inline uint64_t hashBytes(const void* bytes, const size_t size, uint64_t h = FNV_OFFSET) {
+    const auto* data = static_cast<const char*>(bytes);
+    size_t i = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * FNV_PRIME;
+    }
+    for ( ; i < size; ++i ) h = (h ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+    return h;
+}
+
+#endif // HASH_H
@@ -0,0 +1,188 @@
+#include "IvfAssigner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+template<typename T>
+IvfAssigner<T>::IvfAssigner(const size_t k, const size_t dimensions, const size_t lists, const size_t probes) :
+                _k(k),
+                _dimensions(dimensions),
+                _lists(lists ? lists : static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(k))))),
+                _probes(probes),
+                _kernels(Distance::kernels<T>(dimensions))
+{
+    if ( _lists > k ) throw std::invalid_argument("[ERROR] An inverted file can't have more lists than centers.");
+    if ( probes == 0 ) throw std::invalid_argument("[ERROR] An inverted file needs at least one probe.");
+    _probes = std::min(_probes, _lists);
+    _coarse.resize(_lists * dimensions);
+    _owner.resize(k);
+    _members.resize(k * dimensions);
+    _ids.resize(k);
+    _rows.resize(k);
+    _offsets.resize(_lists + 1);
+}
+
+template<typename T> size_t IvfAssigner<T>::lists() const { return _lists; }
+
+template<typename T> size_t IvfAssigner<T>::probes() const { return _probes; }
+
+template<typename T>
+void IvfAssigner<T>::setCenters(const T* centers, ThreadPool& pool) {
+    const size_t d = _dimensions;
+    _centers = centers;
+
+    if ( !_built ) {
+        // evenly spaced centers start the coarse centroids
+        for ( size_t l = 0; l < _lists; ++l ) {
+            std::copy_n(centers + l * _k / _lists * d, d, _coarse.data() + l * d);
+        }
+        _previous.assign(centers, centers + _k * d);
+        group(pool);
+        _built = true;
+        return;
+    }
+
+    std::vector<size_t> moved;
+    for ( size_t c = 0; c < _k; ++c ) {
+        if ( !std::equal(centers + c * d, centers + (c + 1) * d, _previous.begin() + c * d) ) moved.push_back(c);
+    }
+    if ( moved.empty() ) return;
+    std::copy_n(centers, _k * d, _previous.begin());
+
+    if ( static_cast<double>(moved.size()) > REGROUP_FRACTION * static_cast<double>(_k) ) {
+        group(pool);
+        return;
+    }
+
+    //-- incremental: moved centers find their list again, lists are laid out again only if one changed
+    bool relisted = false;
+    for ( const size_t c : moved ) {
+        const int owner = static_cast<int>(_kernels.argmin(centers + c * d, _coarse.data(), _lists));
+        relisted |= owner != _owner[c];
+        _owner[c] = owner;
+    }
+    if ( relisted ) {
+        layout();
+        return;
+    }
+    for ( const size_t c : moved ) std::copy_n(centers + c * d, d, _members.data() + _rows[c] * d);
+}
+
+template<typename T>
+void IvfAssigner<T>::group(ThreadPool& pool) {
+    /*
+     * lloyd over the centers, every center goes to its closest coarse centroid.
+     * ends with an assignment so every center sits in the list of its closest
+     * coarse centroid, then copies the centers of each list next to each other.
+     */
+    const size_t d = _dimensions;
+    const size_t grain = std::max<size_t>(64, _k / (std::max<size_t>(1, pool.numThreads()) * 4));
+    std::vector<double> sums(_lists * d);
+    std::vector<size_t> counts(_lists);
+
+    for ( int iter = 0; ; ++iter ) {
+        pool.parallelFor(0, _k, grain, [this, d](const size_t start, const size_t end) {
+            for ( size_t c = start; c < end; ++c ) {
+                _owner[c] = static_cast<int>(_kernels.argmin(_centers + c * d, _coarse.data(), _lists));
+            }
+        });
+        if ( iter == ( _built ? REFINE_ITERATIONS : BUILD_ITERATIONS ) ) break;
+
+        std::ranges::fill(sums, 0.0);
+        std::ranges::fill(counts, 0);
+        for ( size_t c = 0; c < _k; ++c ) {
+            _kernels.accumulate(_centers + c * d, sums.data() + _owner[c] * d);
+            counts[_owner[c]]++;
+        }
+        for ( size_t l = 0; l < _lists; ++l ) {
+            // an empty list keeps its centroid
+            if ( counts[l] == 0 ) continue;
+            for ( size_t j = 0; j < d; ++j ) {
+                _coarse[l * d + j] = static_cast<T>(sums[l * d + j] / static_cast<double>(counts[l]));
+            }
+        }
+    }
+
+    layout();
+}
+
+template<typename T>
+void IvfAssigner<T>::layout() {
+    // counting sort of the centers by list
+    const size_t d = _dimensions;
+    std::ranges::fill(_offsets, 0);
+    for ( const int owner : _owner ) _offsets[owner + 1]++;
+    std::partial_sum(_offsets.begin(), _offsets.end(), _offsets.begin());
+    std::vector<size_t> next(_offsets.begin(), _offsets.end() - 1);
+    for ( size_t c = 0; c < _k; ++c ) {
+        const size_t row = next[_owner[c]]++;
+        _ids[row] = static_cast<int>(c);
+        _rows[c] = row;
+        std::copy_n(_centers + c * d, d, _members.data() + row * d);
+    }
+}
+
+template<typename T>
+size_t IvfAssigner<T>::assign(const T* points, const size_t begin, const size_t end, int* labels, size_t& computed) const {
+    size_t changed = 0;
+    computed = 0;
+    for ( size_t i = begin; i < end; ++i ) {
+        const int closest = nearest(points + i * _dimensions, labels[i], computed);
+        if ( closest != labels[i] ) {
+            labels[i] = closest;
+            ++changed;
+        }
+    }
+    return changed;
+}
+
+template<typename T>
+int IvfAssigner<T>::nearest(const T* x, const int hint, size_t& computed) const {
+    const size_t d = _dimensions;
+
+    // per thread scratch, kept between calls
+    thread_local std::vector<T> scores;
+    thread_local std::vector<size_t> order;
+    scores.resize(_lists);
+    order.resize(_lists);
+
+    //-- the probed lists: closest coarse centroids first
+    _kernels.squaredL2Block(x, _coarse.data(), _lists, scores.data());
+    computed += _lists;
+    std::iota(order.begin(), order.end(), size_t{0});
+    if ( _probes < _lists ) {
+        std::nth_element(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(_probes), order.end(),
+                         [](const size_t a, const size_t b) { return scores[a] < scores[b]; });
+    }
+
+    //-- the current center competes too, so no point moves away from a closer one
+    T best = std::numeric_limits<T>::infinity();
+    int closest = 0;
+    if ( hint >= 0 ) {
+        best = _kernels.squaredL2(x, _centers + hint * d);
+        closest = hint;
+        ++computed;
+    }
+
+    for ( size_t p = 0; p < _probes; ++p ) {
+        const size_t list = order[p];
+        const size_t first = _offsets[list];
+        const size_t count = _offsets[list + 1] - first;
+        if ( count == 0 ) continue;
+
+        T distance;
+        const size_t index = _kernels.argmin(x, _members.data() + first * d, count, &distance);
+        computed += count;
+        if ( distance < best ) {
+            best = distance;
+            closest = _ids[first + index];
+        }
+    }
+    return closest;
+}
+
+template class IvfAssigner<float>;
+template class IvfAssigner<double>;
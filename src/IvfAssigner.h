@@ -0,0 +1,71 @@
+#ifndef IVFASSIGNER_H
+#define IVFASSIGNER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Distance.h"
+#include "ThreadPool.h"
+
+/*
+ * approximate assignment for very large k with an inverted file over the centers.
+ * a small k-means over the centers themselves splits them into `lists` groups;
+ * a point is only compared with the coarse centroids, the centers of its
+ * `probes` closest groups and the center it was labelled with before.
+ * more probes find the exact closest center more often and cost more; with
+ * probes == lists every center is scanned.
+ * a point never moves to a center farther than its current one, so the
+ * iterations still settle.
+ */
+template<typename T>
+class IvfAssigner {
+public:
+    // k-means iterations over the centers on the first build, and on every later regroup
+    static constexpr int BUILD_ITERATIONS = 8;
+    static constexpr int REFINE_ITERATIONS = 2;
+    // an update moving more than this share of the centers regroups them all
+    static constexpr double REGROUP_FRACTION = 0.25;
+
+    // lists == 0 picks about sqrt(k) lists
+    IvfAssigner(size_t k, size_t dimensions, size_t lists, size_t probes);
+
+    // call after every center update, before assign. when few centers moved,
+    // only those go to their closest list again and the coarse centroids stay;
+    // otherwise all centers are regrouped, starting from the groups of the last call
+    void setCenters(const T* centers, ThreadPool& pool);
+
+    // assigns rows [begin, end). labels are updated in place, returns how many changed.
+    // `computed` receives the number of distances evaluated.
+    // safe to call from several threads.
+    size_t assign(const T* points, size_t begin, size_t end, int* labels, size_t& computed) const;
+
+    [[nodiscard]] size_t lists() const;
+    [[nodiscard]] size_t probes() const;
+
+private:
+    size_t _k;
+    size_t _dimensions;
+    size_t _lists;
+    size_t _probes;
+    Distance::Kernels<T> _kernels;      // bound to _dimensions
+    bool _built = false;
+
+    const T* _centers = nullptr;
+    std::vector<T> _previous;           // centers of the last call
+    AlignedVector<T> _coarse;           // lists x dimensions
+    std::vector<int> _owner;            // list of every center
+    AlignedVector<T> _members;          // centers grouped by list, k x dimensions
+    std::vector<int> _ids;              // center of every row of _members
+    std::vector<size_t> _rows;          // row of every center in _members
+    std::vector<size_t> _offsets;       // list l holds rows [_offsets[l], _offsets[l + 1]) of _members
+
+    void group(ThreadPool& pool);
+    void layout();
+    int nearest(const T* x, int hint, size_t& computed) const;
+};
+
+extern template class IvfAssigner<float>;
+extern template class IvfAssigner<double>;
+
+#endif // IVFASSIGNER_H
@@ -5,174 +5,1139 @@
 #include "Kmeans.h"
 
 #include <algorithm>
-#include <future>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <stdexcept>
 #include <random>
+#include <type_traits>
 
+#include "Distance.h"
+#include "PrunedAssigner.h"
+#include "Seeding.h"
 #include "ThreadPool.h"
+#include "Topology.h"
 #include "Utils.h"
 
-Kmeans::Kmeans(const int k, const int dimensions, const int max_iterations) :
+template<typename T>
+BasicKmeans<T>::BasicKmeans(const int k, const int dimensions, const int max_iterations, const KmeansConfig config) :
                 _k(k),
                 _max_iterations(max_iterations),
-                _point_dimensions(dimensions)
+                _point_dimensions(dimensions),
+                _assignment(config.assignment),
+                _config(config)
 {
     if ( k <= 0 ) throw std::invalid_argument("[ERROR] Number of clusters must be positive.");
-    this->_centers.resize(k);
+    if ( dimensions <= 0 ) throw std::invalid_argument("[ERROR] Number of dimensions must be positive.");
+    this->_centers.resize(static_cast<size_t>(k) * dimensions);
+    _kernels = Distance::kernels<T>(dimensions);
+
+    //-- resolve the assignment engine
+    if ( _assignment == Assignment::Auto ) {
+        _assignment = k * dimensions >= GEMM_THRESHOLD ? Assignment::Gemm : Assignment::Direct;
+    }
+    if ( _assignment == Assignment::Pruned ) {
+        _assignment = k >= ELKAN_MIN_K ? Assignment::Elkan : Assignment::Hamerly;
+    }
+    if ( k == 1 && ( _assignment == Assignment::Hamerly || _assignment == Assignment::Elkan || _assignment == Assignment::Ivf ) ) {
+        _assignment = Assignment::Direct;  // nothing to prune
+    }
+    if ( _assignment == Assignment::Gemm ) _gemm.emplace(k, dimensions);
+    if ( _assignment == Assignment::Ivf ) _ivf.emplace(k, dimensions, config.ivf_lists, config.ivf_probes);
+    _converted = BasicDataset<T>(0, dimensions);
+}
+
+template<typename T> Assignment BasicKmeans<T>::assignment() const { return _assignment; }
+
+template<typename T> const std::vector<size_t>& BasicKmeans<T>::prunedDistances() const { return _pruned_history; }
+template<typename T> size_t BasicKmeans<T>::iterations() const { return _iterations; }
+
+template<typename T>
+double BasicKmeans<T>::inertia(const BasicDataset<T> &points, ThreadPool &pool) const {
+    const size_t dims = _point_dimensions;
+    return pool.parallelReduce(size_t{0}, points.rows(), grainSize(points.rows(), pool), 0.0,
+        [this, &points, dims](const size_t start, const size_t end) {
+            double sum = 0.0;
+            for ( size_t i = start; i < end; ++i ) {
+                sum += _kernels.squaredL2(points.row(i).data(), _centers.data() + points.label(i) * dims);
+            }
+            return sum;
+        }, std::plus<>());
+}
+
+template<typename T>
+double BasicKmeans<T>::agreement(const BasicDataset<T> &points, ThreadPool &pool) const {
+    // a tie with the closest center counts as agreement
+    const size_t dims = _point_dimensions;
+    const size_t agreeing = pool.parallelReduce(size_t{0}, points.rows(), grainSize(points.rows(), pool), size_t{0},
+        [this, &points, dims](const size_t start, const size_t end) {
+            size_t count = 0;
+            for ( size_t i = start; i < end; ++i ) {
+                T best;
+                static_cast<void>(_kernels.argmin(points.row(i).data(), _centers.data(), _k, &best));
+                count += points.label(i) >= 0 &&
+                         _kernels.squaredL2(points.row(i).data(), _centers.data() + points.label(i) * dims) <= best;
+            }
+            return count;
+        }, std::plus<>());
+    return points.empty() ? 1.0 : static_cast<double>(agreeing) / static_cast<double>(points.rows());
+}
+
+template<typename T>
+int BasicKmeans<T>::predict(const std::span<const T> point, T* distance) const {
+    if ( point.size() != static_cast<size_t>(_point_dimensions) ) {
+        throw std::invalid_argument("[ERROR] Point doesn't have a matching number of dimensions.");
+    }
+    const size_t label = _kernels.argmin(point.data(), _centers.data(), _k);
+    if ( distance ) *distance = _kernels.squaredL2(point.data(), _centers.data() + label * _point_dimensions);
+    return static_cast<int>(label);
 }
 
-std::vector<Point> Kmeans::centers() const { return this->_centers; }
+template<typename T>
+void BasicKmeans<T>::predictBatch(const std::span<const T> points, const std::span<int> labels, const std::span<T> distances) const {
+    const size_t dims = _point_dimensions;
+    if ( points.size() != labels.size() * dims || ( !distances.empty() && distances.size() != labels.size() ) ) {
+        throw std::invalid_argument("[ERROR] Points, labels and distances don't have matching sizes.");
+    }
+    predictRange(points.data(), labels.size(), labels.data(), distances.empty() ? nullptr : distances.data());
+}
+
+template<typename T>
+void BasicKmeans<T>::predictBatch(const std::span<const T> points, const std::span<int> labels, ThreadPool &pool,
+                                  const std::span<T> distances) const {
+    const size_t rows = labels.size();
+    if ( rows < PARALLEL_PREDICT_ROWS ) {
+        predictBatch(points, labels, distances);
+        return;
+    }
+    const size_t dims = _point_dimensions;
+    if ( points.size() != rows * dims || ( !distances.empty() && distances.size() != rows ) ) {
+        throw std::invalid_argument("[ERROR] Points, labels and distances don't have matching sizes.");
+    }
+    pool.parallelFor(0, rows, grainSize(rows, pool), [this, points, labels, distances, dims](const size_t start, const size_t end) {
+        predictRange(points.data() + start * dims, end - start, labels.data() + start,
+                     distances.empty() ? nullptr : distances.data() + start);
+    });
+}
+
+template<typename T>
+void BasicKmeans<T>::predictRange(const T* points, const size_t rows, int* labels, T* distances) const {
+    /*
+     * same answers as predict, point by point. the tiled product, when the fit
+     * used it, ranks the centers; rows whose runner-up is within rounding of
+     * the winner are decided by the direct scan predict uses. distances always
+     * come from the direct kernel.
+     */
+    const size_t dims = _point_dimensions;
+    if ( _gemm && rows >= GemmAssigner<T>::MR ) {
+        thread_local std::vector<T> gaps;
+        gaps.resize(rows);
+        // assign updates labels in place and compares against them, the caller's buffer may be uninitialized
+        std::fill_n(labels, rows, -1);
+        _gemm->assign(points, rows, labels, gaps.data());
+        for ( size_t i = 0; i < rows; ++i ) {
+            const T* x = points + i * dims;
+            if ( !(gaps[i] > _gemm->tieMargin(x)) ) labels[i] = static_cast<int>(_kernels.argmin(x, _centers.data(), _k));
+        }
+    }
+    else {
+        for ( size_t i = 0; i < rows; ++i ) labels[i] = static_cast<int>(_kernels.argmin(points + i * dims, _centers.data(), _k));
+    }
+
+    if ( !distances ) return;
+    for ( size_t i = 0; i < rows; ++i ) distances[i] = _kernels.squaredL2(points + i * dims, _centers.data() + labels[i] * dims);
+}
+
+template<typename T>
+void BasicKmeans<T>::publishCenters() {
+    if ( _gemm ) _gemm->setCenters(_centers.data());
+}
 
-void Kmeans::fit(std::vector<Point> &points, ThreadPool& pool) {
+template<typename T>
+std::vector<Point> BasicKmeans<T>::centers() const {
+    std::vector<Point> response;
+    response.reserve(_k);
+    for ( int i = 0; i < _k; ++i ) {
+        const auto c = center(i);
+        response.emplace_back(std::vector<double>(c.begin(), c.end()));
+    }
+    return response;
+}
+
+template<typename T>
+std::span<const T> BasicKmeans<T>::center(const size_t i) const {
+    return {_centers.data() + i * _point_dimensions, static_cast<size_t>(_point_dimensions)};
+}
+
+template<typename T>
+void BasicKmeans<T>::fit(BasicDataset<T> &points, ThreadPool& pool) {
+    _fit_start = std::chrono::steady_clock::now();
     if (!Utils::validate(points, _point_dimensions)) {
         throw std::invalid_argument("[ERROR] Points don't have an matching number of dimensions.");
     }
+    if ( points.rows() < static_cast<size_t>(_k) ) {
+        throw std::invalid_argument("[ERROR] Need at least as many points as clusters.");
+    }
     std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(_config.seed ? *_config.seed : rd());
+
+    _bounds.clear();
+    if ( _config.numa && _config.mode == Mode::FullBatch && !points.isShared() ) placePartitions(points, pool);
+
+    seed(points, pool, gen);
 
-    std::ranges::shuffle(points, gen);
-    for (int i = 0; i < _k; ++i) {
-        _centers[i] = points[i];
+    _pruned.reset();
+    _pruned_history.clear();
+    _iterations = 0;
+
+    if ( _config.mode == Mode::MiniBatch ) {
+        fitMiniBatch(points, pool, gen);
+        return;
     }
 
+    iterate(points, pool);
+}
+
+template<typename T>
+Checkpoint BasicKmeans<T>::checkpoint(const BasicDataset<T> &points, ThreadPool &pool) const {
+    if ( points.dimensions() != static_cast<size_t>(_point_dimensions) ) {
+        throw std::invalid_argument("[ERROR] Points don't have an matching number of dimensions.");
+    }
+    Checkpoint checkpoint;
+    checkpoint.scalar_bytes = sizeof(T);
+    checkpoint.k = _k;
+    checkpoint.dimensions = _point_dimensions;
+    checkpoint.centers.assign(_centers.begin(), _centers.end());
+    checkpoint.labels.assign(points.labels().begin(), points.labels().end());
+    checkpoint.counts.assign(_k, 0);
+    for ( const int label : checkpoint.labels ) {
+        if ( label < 0 || label >= _k ) throw std::invalid_argument("[ERROR] Points are not labelled by this model.");
+        checkpoint.counts[label]++;
+    }
+    checkpoint.row_hashes = Checkpoint::hashRows(points, pool);
+    return checkpoint;
+}
+
+template<typename T>
+void BasicKmeans<T>::resume(BasicDataset<T> &points, ThreadPool &pool, const Checkpoint &checkpoint) {
+    _fit_start = std::chrono::steady_clock::now();
+    if ( checkpoint.k != static_cast<size_t>(_k) || checkpoint.dimensions != static_cast<size_t>(_point_dimensions)
+         || checkpoint.counts.size() != static_cast<size_t>(_k) ) {
+        throw std::invalid_argument("[ERROR] Checkpoint was made for a different k or number of dimensions.");
+    }
+    if ( checkpoint.scalar_bytes != sizeof(T) ) {
+        throw std::invalid_argument("[ERROR] Checkpoint was made by a model with a different scalar type.");
+    }
+    if ( points.dimensions() != static_cast<size_t>(_point_dimensions) ) {
+        throw std::invalid_argument("[ERROR] Points don't have an matching number of dimensions.");
+    }
+    if ( points.rows() < static_cast<size_t>(_k) ) {
+        throw std::invalid_argument("[ERROR] Need at least as many points as clusters.");
+    }
+    std::random_device rd;
+    std::mt19937 gen(_config.seed ? *_config.seed : rd());
+
+    _bounds.clear();
+    if ( _config.numa && _config.mode == Mode::FullBatch && !points.isShared() ) placePartitions(points, pool);
+
+    std::ranges::transform(checkpoint.centers, _centers.begin(), [](const double c) { return static_cast<T>(c); });
+    _pruned.reset();
+    _pruned_history.clear();
+    _iterations = 0;
+
+    //-- unchanged rows keep their label, the others go to their closest center
+    const size_t rows = points.rows();
+    const size_t kept = std::min(rows, checkpoint.labels.size());
+    const std::vector<uint64_t> hashes = Checkpoint::hashRows(points, pool);
+    std::vector<std::atomic<bool>> affected(_k);
+    std::vector<std::atomic<int64_t>> joined(_k);      // rows that joined minus rows that left, per center
+    std::atomic<size_t> dirty = 0;
+
+    pool.parallelFor(0, rows, grainSize(rows, pool), [&](const size_t start, const size_t end) {
+        size_t reassigned = 0;
+        for ( size_t i = start; i < end; ++i ) {
+            const bool known = i < kept;
+            if ( known && hashes[i] == checkpoint.row_hashes[i] ) {
+                points.setLabel(i, checkpoint.labels[i]);
+                continue;
+            }
+            // a changed row leaves its old center and joins its closest one
+            const int closest = static_cast<int>(findClosestCluster(points.row(i)));
+            points.setLabel(i, closest);
+            affected[closest].store(true, std::memory_order_relaxed);
+            joined[closest].fetch_add(1, std::memory_order_relaxed);
+            if ( known ) {
+                affected[checkpoint.labels[i]].store(true, std::memory_order_relaxed);
+                joined[checkpoint.labels[i]].fetch_sub(1, std::memory_order_relaxed);
+            }
+            ++reassigned;
+        }
+        dirty.fetch_add(reassigned, std::memory_order_relaxed);
+    });
+    // removed rows leave their center too
+    for ( size_t i = kept; i < checkpoint.labels.size(); ++i ) {
+        affected[checkpoint.labels[i]] = true;
+        joined[checkpoint.labels[i]].fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    //-- move the affected centers only
+    prepareArenas(pool);
+    ++_epoch;
+    forEachRange(points, pool, [this, &points](const size_t start, const size_t end, const size_t slot) {
+        addRange(points, start, end, slot, false);
+    });
+    reduceArenas(pool);
+    std::vector<size_t> counts(_arena_counts.data(), _arena_counts.data() + _k);
+    size_t moved = 0;
+    for ( size_t cluster_id = 0; cluster_id < static_cast<size_t>(_k); ++cluster_id ) {
+        if ( affected[cluster_id] ) ++moved;
+        else counts[cluster_id] = 0;
+    }
+    moveCenters(_arena_sums.data(), counts.data());
+    if ( _config.verbose ) {
+        std::cout << "Resumed with " << dirty.load() << " changed rows and " << moved << " affected centers." << std::endl;
+    }
+
+    if ( _config.mode == Mode::MiniBatch ) {
+        // centers keep the weight of the points they had absorbed, moved by the rows that changed hands
+        std::vector<size_t> seen(_k);
+        for ( size_t cluster_id = 0; cluster_id < static_cast<size_t>(_k); ++cluster_id ) {
+            const int64_t weight = static_cast<int64_t>(checkpoint.counts[cluster_id]) + joined[cluster_id].load();
+            seen[cluster_id] = static_cast<size_t>(std::max<int64_t>(0, weight));
+        }
+        fitMiniBatch(points, pool, gen, std::move(seen));
+        return;
+    }
+
+    iterate(points, pool);
+}
+
+template<typename T>
+void BasicKmeans<T>::iterate(BasicDataset<T> &points, ThreadPool &pool) {
+    if ( _assignment == Assignment::Hamerly || _assignment == Assignment::Elkan ) {
+        const auto method = _assignment == Assignment::Elkan ? PrunedAssigner<T>::Method::Elkan : PrunedAssigner<T>::Method::Hamerly;
+        _pruned.emplace(method, points.rows(), _k, _point_dimensions);
+    }
+
+    prepareArenas(pool);
+
+    const bool with_inertia = _observer || _config.inertia_tolerance > 0.0;
+    double previous_inertia = -1.0;
     for (int iter = 0; iter < _max_iterations; ++iter) {
-        std::atomic<bool> converged = true;
-        std::vector<std::future<void>> futures;
-
-        // group using threads
-        const size_t batchSize = points.size() / pool.numThreads();
-        for (size_t start = 0; start < points.size(); start += batchSize) {
-
-            futures.push_back(pool.enqueue([this, &points, &converged, start, batchSize]() {
-                const size_t end = std::min(start + batchSize, points.size());
-
-                for (size_t i = start; i < end; i++) {
-                    int closest_cluster = static_cast<int>(findClosestCluster(points[i]));
-                    if (closest_cluster != points[i].cluster()) {
-                        points[i].setCluster(closest_cluster);
-                        converged = false;
-                    }
-                }
-            }));
+        IterationMetrics metrics;
+        startIteration(metrics, iter);
+
+        ++_epoch;
+        assignAndAccumulate(points, pool, with_inertia);
+        metrics.assign_ms = millisSinceStart() - metrics.start_ms;
+
+        const Arena& totals = reduceArenas(pool);
+        metrics.changed = totals.changed;
+        metrics.computed = totals.computed;
+        metrics.inertia = totals.inertia;
+        metrics.merge_ms = millisSinceStart() - metrics.start_ms - metrics.assign_ms;
+        if ( _config.reseed_empty ) metrics.reseeded = reseedEmpty(points, pool);
+        moveCenters(_arena_sums.data(), _arena_counts.data(), &metrics);
+        metrics.update_ms = millisSinceStart() - metrics.start_ms - metrics.assign_ms - metrics.merge_ms;
+        _pruned_history.push_back(points.rows() * _k - metrics.computed);
+        ++_iterations;
+        finishIteration(metrics);
+
+        if ( metrics.changed == 0 && metrics.reseeded == 0 ) {
+            if ( _config.verbose ) std::cout << "Finished earlier due to convergence. Total iterations: " << iter + 1 << std::endl;
+            break;
         }
-        // Wait for all tasks to finish.
-        for (auto &future : futures) {
-            future.get();
+        if ( settled(metrics, points.rows(), previous_inertia) ) {
+            if ( _config.verbose ) std::cout << "Finished earlier within tolerance. Total iterations: " << iter + 1 << std::endl;
+            break;
+        }
+        previous_inertia = metrics.inertia;
+    }
+    publishCenters();
+}
+
+template<typename T>
+void BasicKmeans<T>::fit(BasicDataset<T> &shard, ThreadPool &pool, Transport &transport) {
+    _fit_start = std::chrono::steady_clock::now();
+    if ( _config.mode != Mode::FullBatch ) {
+        throw std::invalid_argument("[ERROR] Distributed fits are full batch only.");
+    }
+    if ( !shard.empty() && shard.dimensions() != static_cast<size_t>(_point_dimensions) ) {
+        throw std::invalid_argument("[ERROR] Points don't have an matching number of dimensions.");
+    }
+    std::random_device rd;
+    std::mt19937 gen(_config.seed ? *_config.seed : rd());
+
+    _bounds.clear();
+    if ( _config.numa && !shard.empty() && !shard.isShared() ) placePartitions(shard, pool);
+
+    //-- the same starting centers everywhere
+    if ( transport.rank() == 0 ) {
+        if ( shard.rows() < static_cast<size_t>(_k) ) {
+            throw std::invalid_argument("[ERROR] Need at least as many points as clusters.");
         }
+        seed(shard, pool, gen);
+    }
+    transport.broadcast(std::as_writable_bytes(std::span<T>(_centers.data(), _centers.size())));
+
+    _pruned.reset();
+    _pruned_history.clear();
+    _iterations = 0;
+    if ( ( _assignment == Assignment::Hamerly || _assignment == Assignment::Elkan ) && !shard.empty() ) {
+        const auto method = _assignment == Assignment::Elkan ? PrunedAssigner<T>::Method::Elkan : PrunedAssigner<T>::Method::Hamerly;
+        _pruned.emplace(method, shard.rows(), _k, _point_dimensions);
+    }
+
+    prepareArenas(pool);
+
+    const size_t k = _k;
+    const size_t values = k * _point_dimensions;
+    std::vector<uint64_t> tallies(k + 3);  // counts, changed, computed, rows
+
+    // observers are set per rank, so every rank always computes and all-reduces the
+    // inertia: a collective that depends on one rank's observer would hang the others
+    double previous_inertia = -1.0;
+    for (int iter = 0; iter < _max_iterations; ++iter) {
+        IterationMetrics metrics;
+        startIteration(metrics, iter);
+
+        ++_epoch;
+        assignAndAccumulate(shard, pool, true);
+        metrics.assign_ms = millisSinceStart() - metrics.start_ms;
+        const Arena& totals = reduceArenas(pool);
+        double inertia = totals.inertia;
+        metrics.merge_ms = millisSinceStart() - metrics.start_ms - metrics.assign_ms;
 
-        updateCenters(points, pool);
+        //-- every rank gets the totals and moves its centers the same way
+        transport.allReduce(std::span<double>(_arena_sums.data(), values));
+        std::copy_n(_arena_counts.data(), k, tallies.begin());
+        tallies[k] = totals.changed;
+        tallies[k + 1] = totals.computed;
+        tallies[k + 2] = shard.rows();
+        transport.allReduce(std::span<uint64_t>(tallies));
+        std::copy_n(tallies.begin(), k, _arena_counts.data());
+        transport.allReduce(std::span<double>(&inertia, 1));
 
-        if (converged) {
-            std::cout << "Finished earlier due to convergence. Total iterations: " << iter + 1 << std::endl;
+        metrics.changed = tallies[k];
+        metrics.computed = tallies[k + 1];
+        metrics.inertia = inertia;
+        _pruned_history.push_back(tallies[k + 2] * k - tallies[k + 1]);
+        ++_iterations;
+        metrics.reduce_ms = millisSinceStart() - metrics.start_ms - metrics.assign_ms - metrics.merge_ms;
+        moveCenters(_arena_sums.data(), _arena_counts.data(), &metrics);
+        metrics.update_ms = millisSinceStart() - metrics.start_ms - metrics.assign_ms - metrics.merge_ms - metrics.reduce_ms;
+        finishIteration(metrics);
+
+        // every rank sees the same totals and shifts, so all of them stop together
+        if ( tallies[k] == 0 ) {
+            if ( _config.verbose && transport.rank() == 0 ) {
+                std::cout << "Finished earlier due to convergence. Total iterations: " << iter + 1 << std::endl;
+            }
             break;
         }
+        if ( settled(metrics, tallies[k + 2], previous_inertia) ) {
+            if ( _config.verbose && transport.rank() == 0 ) {
+                std::cout << "Finished earlier within tolerance. Total iterations: " << iter + 1 << std::endl;
+            }
+            break;
+        }
+        previous_inertia = inertia;
     }
+    publishCenters();
 }
 
-size_t Kmeans::findClosestCluster(const Point &point) const {
+template<typename T>
+void BasicKmeans<T>::fit(ChunkReader &reader, ThreadPool &pool, const LabelSink &sink) {
+    /*
+     * lloyd or mini-batch where the data is only ever seen one chunk at a time.
+     * the reader parses the next chunk while the pool works on the current one,
+     * so memory stays at two chunks plus the k x dimensions sums.
+     */
+    _fit_start = std::chrono::steady_clock::now();
+    if ( reader.dimensions() != static_cast<size_t>(_point_dimensions) ) {
+        throw std::invalid_argument("[ERROR] Points don't have an matching number of dimensions.");
+    }
+    std::random_device rd;
+    std::mt19937 gen(_config.seed ? *_config.seed : rd());
+
+    // the assignment bounds would need state for every row
+    _pruned.reset();
+    _pruned_history.clear();
+    _iterations = 0;
+    _bounds.clear();
+
+    //-- seed from a uniform reservoir sample of one chunk's size
+    const size_t capacity = std::max(reader.chunkRows(), static_cast<size_t>(_k));
+    BasicDataset<T> sample(0, _point_dimensions);
+    sample.reserve(capacity);
+    size_t seen_rows = 0;
+
+    reader.rewind();
+    while ( Dataset* parsed = reader.next() ) {
+        const BasicDataset<T>& chunk = typed(*parsed);
+        for ( size_t i = 0; i < chunk.rows(); ++i, ++seen_rows ) {
+            if ( sample.rows() < capacity ) {
+                sample.append(chunk.row(i));
+                continue;
+            }
+            const size_t slot = std::uniform_int_distribution<size_t>(0, seen_rows)(gen);
+            if ( slot < capacity ) std::ranges::copy(chunk.row(i), sample.row(slot).begin());
+        }
+    }
+    if ( sample.rows() < static_cast<size_t>(_k) ) {
+        throw std::invalid_argument("[ERROR] Need at least as many points as clusters.");
+    }
+    seed(sample, pool, gen);
+    prepareArenas(pool);
+
+    //-- passes over the file
+    const size_t k = _k;
+    const size_t dims = _point_dimensions;
+    std::vector<size_t> absorbed(k, 0);    // mini-batch: points each center has seen
+    const double* total_sums = _arena_sums.data();
+    const size_t* cluster_counts = _arena_counts.data();
+
+    const bool mini_batch = _config.mode == Mode::MiniBatch;
+    const double alpha = std::min(1.0, 2.0 * static_cast<double>(reader.chunkRows()) / static_cast<double>(seen_rows + 1));
+    double smoothed = -1.0;
+    double best = std::numeric_limits<double>::infinity();
+    int no_improvement = 0;
+    bool stop = false;
+
+    const bool with_inertia = ( _observer || _config.inertia_tolerance > 0.0 ) && !mini_batch;
+    double previous_inertia = -1.0;
+    for ( int iter = 0; iter < _max_iterations && !stop; ++iter ) {
+        IterationMetrics metrics;
+        startIteration(metrics, iter);
+        size_t pass_computed = 0;
+
+        // full batch: arenas add up over the whole pass
+        ++_epoch;
+        reader.rewind();
+        while ( Dataset* parsed = reader.next() ) {
+            BasicDataset<T>& chunk = typed(*parsed);
+
+            if ( !mini_batch ) {
+                assignAndAccumulate(chunk, pool, with_inertia);
+                continue;
+            }
 
-    // compute distance to the first center
-    double minDistance = Utils::euclideanDistance(point, _centers.at(0));
-    size_t closestCluster = 0;
+            //-- every chunk is a batch
+            ++_epoch;
+            ++_iterations;
+            assignAndAccumulate(chunk, pool, true);
+            const Arena& batch = reduceArenas(pool);
+            pass_computed += batch.computed;
+            const double inertia = batch.inertia / static_cast<double>(chunk.rows());
 
-    // find min distance
-    for ( size_t i = 1; i < _centers.size(); ++i ) {
+            for ( size_t cluster_id = 0; cluster_id < k; ++cluster_id ) {
+                if ( cluster_counts[cluster_id] == 0 ) continue;
+                absorbed[cluster_id] += cluster_counts[cluster_id];
+                const double rate = 1.0 / static_cast<double>(absorbed[cluster_id]);
+                for ( size_t d = 0; d < dims; ++d ) {
+                    const double c = _centers[cluster_id * dims + d];
+                    _centers[cluster_id * dims + d] =
+                        static_cast<T>(c + (total_sums[cluster_id * dims + d] - static_cast<double>(cluster_counts[cluster_id]) * c) * rate);
+                }
+            }
 
-        if (const double distance = Utils::euclideanDistance(point,_centers.at(i)); distance < minDistance ) {
-            closestCluster = i;
-            minDistance = distance;
+            smoothed = smoothed < 0 ? inertia : smoothed * (1.0 - alpha) + inertia * alpha;
+            if ( smoothed < best ) {
+                best = smoothed;
+                no_improvement = 0;
+            }
+            else if ( ++no_improvement >= _config.max_no_improvement ) {
+                if ( _config.verbose ) std::cout << "Finished earlier due to no improvement. Total passes: " << iter + 1 << std::endl;
+                stop = true;
+                break;
+            }
+        }
+        if ( mini_batch ) {
+            _pruned_history.push_back(seen_rows * k - pass_computed);
+            continue;
         }
 
+        // same labels as the pass before give the same sums, so unmoved centers mean convergence
+        metrics.assign_ms = millisSinceStart() - metrics.start_ms;
+        const Arena& totals = reduceArenas(pool);
+        metrics.computed = totals.computed;
+        metrics.inertia = totals.inertia;
+        _pruned_history.push_back(seen_rows * k - totals.computed);
+        ++_iterations;
+        metrics.merge_ms = millisSinceStart() - metrics.start_ms - metrics.assign_ms;
+        const bool moved = moveCenters(total_sums, cluster_counts, &metrics);
+        metrics.update_ms = millisSinceStart() - metrics.start_ms - metrics.assign_ms - metrics.merge_ms;
+        finishIteration(metrics);
+
+        if ( !moved ) {
+            if ( _config.verbose ) std::cout << "Finished earlier due to convergence. Total iterations: " << iter + 1 << std::endl;
+            break;
+        }
+        // labels are not kept between passes, so no rows count for the moved fraction
+        if ( settled(metrics, 0, previous_inertia) ) {
+            if ( _config.verbose ) std::cout << "Finished earlier within tolerance. Total iterations: " << iter + 1 << std::endl;
+            break;
+        }
+        previous_inertia = metrics.inertia;
+    }
+
+    publishCenters();
+
+    //-- one more pass to hand out the final labels
+    if ( !sink ) return;
+    reader.rewind();
+    while ( Dataset* parsed = reader.next() ) {
+        BasicDataset<T>& chunk = typed(*parsed);
+        size_t computed;
+        assignPoints(chunk, pool, computed);
+        sink(reader.firstRow(), chunk.labels());
     }
+}
+
+template<typename T>
+BasicDataset<T>& BasicKmeans<T>::typed(Dataset &chunk) {
+    // chunks are always parsed as double, narrower runs convert them into one reused buffer
+    if constexpr ( std::is_same_v<T, double> ) {
+        return chunk;
+    } else {
+        _converted.resize(chunk.rows());
+        const auto from = chunk.values();
+        const auto to = _converted.values();
+        for ( size_t i = 0; i < from.size(); ++i ) to[i] = static_cast<T>(from[i]);
+        std::ranges::copy(chunk.labels(), _converted.labels().begin());
+        return _converted;
+    }
+}
+
+template<typename T>
+void BasicKmeans<T>::seed(const BasicDataset<T> &points, ThreadPool &pool, std::mt19937 &gen) {
+    // initial centers come from the caller's rows, which are never reordered
+    switch ( _config.initialization ) {
+        case Initialization::Random:
+            Seeding::random(points, _k, _centers.data(), gen);
+            break;
+        case Initialization::KmeansPlusPlus:
+            Seeding::kmeansPlusPlus(points, _k, _centers.data(), pool, gen);
+            break;
+        case Initialization::KmeansParallel:
+            Seeding::kmeansParallel(points, _k, _centers.data(), pool, gen, _config.parallel_rounds, _config.oversampling);
+            break;
+    }
+}
+
+template<typename T>
+size_t BasicKmeans<T>::grainSize(const size_t rows, const ThreadPool &pool) {
+    // a few chunks per thread, so idle threads can steal from slow ones
+    return std::max<size_t>(256, rows / (std::max<size_t>(1, pool.numThreads()) * CHUNKS_PER_THREAD));
+}
+
+template<typename T>
+bool BasicKmeans<T>::assignPoints(BasicDataset<T> &points, ThreadPool &pool, size_t &computed) {
+    /*
+     * label every point with its closest center.
+     * returns true if any label changed, `computed` receives the number of distances evaluated.
+     */
+    if ( _gemm ) _gemm->setCenters(_centers.data());
+    if ( _pruned ) _pruned->setCenters(_centers.data());
+    if ( _ivf ) _ivf->setCenters(_centers.data(), pool);
+
+    // group using threads. every chunk returns how many labels changed and distances it computed
+    using Tally = std::pair<size_t, size_t>;
+    const auto [changed, total] = pool.parallelReduce(size_t{0}, points.rows(), grainSize(points.rows(), pool), Tally{0, 0},
+        [this, &points](const size_t start, const size_t end) {
+            size_t moved = 0;
+            const size_t distances = assignRange(points, start, end, moved);
+            return Tally{moved, distances};
+        },
+        [](const Tally &a, const Tally &b) { return Tally{a.first + b.first, a.second + b.second}; });
 
-    return closestCluster;
+    computed = total;
+    return changed != 0;
 }
 
-void Kmeans::updateCenters(const std::vector<Point> &points, ThreadPool &pool) {
+template<typename T>
+size_t BasicKmeans<T>::assignRange(BasicDataset<T> &points, const size_t start, const size_t end, size_t &changed) {
     /*
-     * move cluster centers to the mean between all the points
-    */
+     * labels rows [start, end) with the engine chosen at construction and adds
+     * the number of changed labels to `changed`.
+     * returns the number of distances evaluated.
+     */
+    const auto labels = points.labels();
+    size_t moved = 0;
+    size_t computed = (end - start) * _k;
 
-    if ( ! Utils::validate(points,_point_dimensions) ) {
-        throw std::invalid_argument( "[ERROR] Points don't have an matching number of dimensions.");
+    if ( _gemm ) {
+        moved = _gemm->assign(points.row(start).data(), end - start, labels.data() + start);
+    }
+    else if ( _pruned ) {
+        moved = _pruned->assign(points.values().data(), start, end, labels.data(), computed);
+    }
+    else if ( _ivf ) {
+        size_t probed;
+        moved = _ivf->assign(points.values().data(), start, end, labels.data(), probed);
+        // probing every list costs a few distances more than the full scan
+        computed = std::min(computed, probed);
+    }
+    else {
+        for (size_t i = start; i < end; i++) {
+            int closest_cluster = static_cast<int>(findClosestCluster(points.row(i)));
+            if (closest_cluster != points.label(i)) {
+                points.setLabel(i, closest_cluster);
+                ++moved;
+            }
+        }
     }
 
-    const size_t totalPoints = points.size();
-    const size_t numThreads = pool.numThreads();
-    const size_t batch_size = totalPoints / numThreads;
+    changed += moved;
+    return computed;
+}
 
-    std::vector< std::future< std::pair<std::vector<int> ,std::vector<std::vector<double>>>>> futures;
+template<typename T>
+void BasicKmeans<T>::fitMiniBatch(BasicDataset<T> &points, ThreadPool &pool, std::mt19937 &gen, std::vector<size_t> seen) {
+    /*
+     * each step samples a batch, assigns it and pulls every center towards the
+     * mean of its batch points with a per center learning rate of
+     * batch_count / total_count, so centers that have seen many points move less.
+     * stops once the smoothed batch inertia has not improved for a while.
+     */
+    const size_t rows = points.rows();
+    const size_t k = _k;
+    const size_t dims = _point_dimensions;
+    const size_t batch = std::min(std::max<size_t>(1, _config.batch_size), rows);
+    const size_t steps = static_cast<size_t>(_max_iterations) * ((rows + batch - 1) / batch);
 
-    //-- compute using batches and threads
-    for ( size_t start = 0; start < totalPoints; start+=batch_size ) {
-        futures.push_back( pool.enqueue(
-                [this,&points,start,batch_size,totalPoints]()->std::pair<std::vector<int>,std::vector<std::vector<double>>> {
+    std::vector<size_t> indices(batch);
+    std::vector<int> batch_labels(batch);
+    std::vector<T> batch_distances(batch);
+    std::vector<double> batch_sums(k * dims);
+    std::vector<size_t> batch_counts(k);
+    seen.resize(k, 0);                // points each center has absorbed so far
 
-                    // need to save local data and return it with future
-                    std::vector<int> local_counts(_k, 0);
-                    std::vector<std::vector<double>> local_sums(_k, std::vector<double>(_point_dimensions, 0.0));
+    // exponentially weighted inertia, weighted like a batch out of the whole dataset
+    const double alpha = std::min(1.0, 2.0 * static_cast<double>(batch) / static_cast<double>(rows + 1));
+    double smoothed = -1.0;
+    double best = std::numeric_limits<double>::infinity();
+    int no_improvement = 0;
 
+    std::uniform_int_distribution<size_t> pick(0, rows - 1);
 
-                    const size_t end = std::min(start+batch_size, totalPoints);
+    for ( size_t step = 0; step < steps; ++step ) {
+        ++_iterations;
+        for ( auto& i : indices ) i = pick(gen);
 
-                    // iterate over the batch
-                    for ( size_t i = start; i < end; ++i ) {
-                        int cluster_id = points[i].cluster();
-                        const auto& point_coordinates = points[i].cords();
+        //-- assign the batch using threads
+        double inertia = pool.parallelReduce(size_t{0}, batch, grainSize(batch, pool), 0.0,
+            [&](const size_t start, const size_t end) -> double {
+                double inertia = 0.0;
+                for ( size_t b = start; b < end; ++b ) {
+                    batch_labels[b] = static_cast<int>(_kernels.argmin(
+                        points.row(indices[b]).data(), _centers.data(), k, &batch_distances[b]));
+                    inertia += batch_distances[b];
+                }
+                return inertia;
+            }, std::plus<>());
+        inertia /= static_cast<double>(batch);
 
-                        // sum to local
-                        for ( size_t d = 0; d < _point_dimensions; ++d) {
-                            // sum to the correct dimension
-                            local_sums[cluster_id][d] += point_coordinates[d];
-                        }
+        //-- per center batch means
+        std::ranges::fill(batch_sums, 0.0);
+        std::ranges::fill(batch_counts, 0);
+        for ( size_t b = 0; b < batch; ++b ) {
+            const size_t cluster_id = batch_labels[b];
+            _kernels.accumulate(points.row(indices[b]).data(), batch_sums.data() + cluster_id * dims);
+            batch_counts[cluster_id]++;
+        }
+
+        //-- move centers
+        for ( size_t cluster_id = 0; cluster_id < k; ++cluster_id ) {
+            if ( batch_counts[cluster_id] == 0 ) continue;
 
-                        // increment counter
-                        local_counts[cluster_id]++;
-                    }
-                    return std::make_pair(local_counts,local_sums);
-            }));
+            seen[cluster_id] += batch_counts[cluster_id];
+            const double rate = 1.0 / static_cast<double>(seen[cluster_id]);
+            T* center = _centers.data() + cluster_id * dims;
+            const double* sums = batch_sums.data() + cluster_id * dims;
 
+            // c += (sum - count * c) / seen  ==  weighted mean of old center and batch
+            for ( size_t d = 0; d < dims; ++d ) {
+                const double c = center[d];
+                center[d] = static_cast<T>(c + (sums[d] - static_cast<double>(batch_counts[cluster_id]) * c) * rate);
+            }
+        }
+
+        //-- early stop on the smoothed inertia
+        smoothed = smoothed < 0 ? inertia : smoothed * (1.0 - alpha) + inertia * alpha;
+        if ( smoothed < best ) {
+            best = smoothed;
+            no_improvement = 0;
+        }
+        else if ( ++no_improvement >= _config.max_no_improvement ) {
+            if ( _config.verbose ) std::cout << "Finished earlier due to no improvement. Total steps: " << step + 1 << std::endl;
+            break;
+        }
     }
 
-    //-- sum all local counts and sums
-    std::vector<int> cluster_counts(_k, 0);
-    std::vector<std::vector<double>> total_sums(_k, std::vector<double>(_point_dimensions, 0.0));
-    for ( auto& future: futures ) {
-        auto [partial_counts, partial_sums] = future.get();
-        for ( size_t cluster_id = 0; cluster_id < _k; ++ cluster_id) {
+    // final labels for every point
+    size_t computed;
+    assignPoints(points, pool, computed);
+}
 
-            // update counter
-            cluster_counts[cluster_id] += partial_counts[cluster_id];
+template<typename T>
+size_t BasicKmeans<T>::findClosestCluster(const std::span<const T> point) const {
+    // squared distances keep the same argmin, the block kernel scores several centers per pass
+    return _kernels.argmin(point.data(), _centers.data(), _k);
+}
 
-            // update all coordinates sum
-            for ( size_t d = 0; d < _point_dimensions; ++d) {
-                total_sums[cluster_id][d] += partial_sums[cluster_id][d];
-            }
+template<typename T>
+void BasicKmeans<T>::prepareArenas(const ThreadPool &pool) {
+    // one arena per worker plus one for the calling thread, each starting on its own cache line
+    constexpr size_t line = 64;
+    const size_t slots = pool.numThreads() + 1;
+    const size_t sum_stride = (static_cast<size_t>(_k) * _point_dimensions * sizeof(double) + line - 1) / line * line / sizeof(double);
+    const size_t count_stride = (static_cast<size_t>(_k) * sizeof(size_t) + line - 1) / line * line / sizeof(size_t);
+
+    _loads.resize(slots);
+    if ( _arenas.size() == slots && _sum_stride == sum_stride && _count_stride == count_stride ) return;
+    _sum_stride = sum_stride;
+    _count_stride = count_stride;
+    _arena_sums.assign(slots * sum_stride, 0.0);
+    _arena_counts.assign(slots * count_stride, 0);
+    _arenas.assign(slots, Arena{});
+    _epoch = 0;
+}
+
+template<typename T>
+void BasicKmeans<T>::placePartitions(BasicDataset<T> &points, ThreadPool &pool) {
+    /*
+     * cuts the rows into one fixed range per worker, in worker order, so the
+     * workers of a node hold one contiguous block. the values move into fresh
+     * pages that each worker writes first: the kernel places them on that
+     * worker's node and every later pass reads local memory.
+     */
+    const size_t workers = std::max<size_t>(1, pool.numThreads());
+    const size_t rows = points.rows();
+    const size_t dims = _point_dimensions;
+
+    _bounds.resize(workers + 1);
+    for ( size_t w = 0; w <= workers; ++w ) _bounds[w] = rows * w / workers;
+
+    auto owner = Topology::untouched(rows * dims * sizeof(T));
+    T* const values = static_cast<T*>(owner.get());
+    const T* const source = points.values().data();
+    pool.forEachWorker([this, values, source, dims](const size_t w) {
+        std::copy(source + _bounds[w] * dims, source + _bounds[w + 1] * dims, values + _bounds[w] * dims);
+    });
+
+    BasicDataset<T> placed(values, rows, dims, std::move(owner));
+    std::ranges::copy(points.labels(), placed.labels().begin());
+    points = std::move(placed);
+}
+
+template<typename T>
+void BasicKmeans<T>::accumulateRange(BasicDataset<T> &points, const size_t start, const size_t end, const size_t slot,
+                                     const bool with_inertia) {
+    /*
+     * labels rows [start, end) and adds them to arena `slot` while they are
+     * still in cache, with the changed labels and distances evaluated.
+     */
+    size_t changed = 0;
+    const size_t computed = assignRange(points, start, end, changed);
+    addRange(points, start, end, slot, with_inertia);
+    _arenas[slot].changed += changed;
+    _arenas[slot].computed += computed;
+}
+
+template<typename T>
+void BasicKmeans<T>::addRange(const BasicDataset<T> &points, const size_t start, const size_t end, const size_t slot,
+                              const bool with_inertia) {
+    // adds the labelled rows [start, end) to arena `slot`
+    const size_t dims = _point_dimensions;
+    Arena& arena = _arenas[slot];
+    double* const sums = _arena_sums.data() + slot * _sum_stride;
+    size_t* const counts = _arena_counts.data() + slot * _count_stride;
+    if ( arena.epoch != _epoch ) {
+        std::fill_n(sums, _sum_stride, 0.0);
+        std::fill_n(counts, _count_stride, 0);
+        arena = Arena{};
+        arena.epoch = _epoch;
+    }
+
+    double inertia = 0.0;
+    for ( size_t i = start; i < end; ++i ) {
+        const size_t cluster_id = points.label(i);
+        const T* point_coordinates = points.row(i).data();
+        _kernels.accumulate(point_coordinates, sums + cluster_id * dims);
+        counts[cluster_id]++;
+
+        if ( with_inertia ) inertia += _kernels.squaredL2(point_coordinates, _centers.data() + cluster_id * dims);
+    }
+    arena.inertia += inertia;
+}
+
+template<typename T>
+void BasicKmeans<T>::assignAndAccumulate(BasicDataset<T> &points, ThreadPool &pool, const bool with_inertia) {
+    /*
+     * one pass that labels every point and adds it to the arena of the thread
+     * that labelled it. arenas touched for the first time in the current
+     * epoch are cleared first, so several calls can add up before reduceArenas.
+     * counts stay in the arenas too, no thread writes shared state.
+     */
+    if ( _gemm ) _gemm->setCenters(_centers.data());
+    if ( _pruned ) _pruned->setCenters(_centers.data());
+    if ( _ivf ) _ivf->setCenters(_centers.data(), pool);
+
+    forEachRange(points, pool, [this, &points, with_inertia](const size_t start, const size_t end, const size_t slot) {
+        if ( !_observer ) {
+            accumulateRange(points, start, end, slot, with_inertia);
+            return;
         }
+        // only the thread of a slot writes its load
+        const double begin = millisSinceStart();
+        accumulateRange(points, start, end, slot, with_inertia);
+        const double finish = millisSinceStart();
+
+        IterationMetrics::Worker& load = _loads[slot].worker;
+        if ( load.chunks++ == 0 ) load.first_ms = begin;
+        load.last_ms = finish;
+        load.busy_ms += finish - begin;
+        load.rows += end - start;
+    });
+}
+
+template<typename T>
+template<typename F>
+void BasicKmeans<T>::forEachRange(const BasicDataset<T> &points, ThreadPool &pool, F &&fn) {
+    // calls fn(start, end, arena slot) over all rows, from the thread that owns the slot
+    if ( !_bounds.empty() ) {
+        // numa: every worker keeps to the rows in its node's memory
+        pool.forEachWorker([this, &fn](const size_t w) {
+            if ( _bounds[w] == _bounds[w + 1] ) return;
+            fn(_bounds[w], _bounds[w + 1], w);
+        });
+    } else {
+        pool.parallelFor(0, points.rows(), grainSize(points.rows(), pool), [&pool, &fn](const size_t start, const size_t end) {
+            fn(start, end, pool.workerIndex());
+        });
     }
+}
+
+template<typename T>
+void BasicKmeans<T>::mergeArena(const size_t into, const size_t from) {
+    // adds arena `from` to arena `into`, only data of the current epoch counts
+    if ( _arenas[from].epoch != _epoch ) return;
+
+    double* sums = _arena_sums.data() + into * _sum_stride;
+    size_t* counts = _arena_counts.data() + into * _count_stride;
+    const double* other_sums = _arena_sums.data() + from * _sum_stride;
+    const size_t* other_counts = _arena_counts.data() + from * _count_stride;
+
+    if ( _arenas[into].epoch != _epoch ) {
+        std::copy_n(other_sums, _sum_stride, sums);
+        std::copy_n(other_counts, _count_stride, counts);
+        _arenas[into] = _arenas[from];
+        return;
+    }
+    for ( size_t j = 0; j < _sum_stride; ++j ) sums[j] += other_sums[j];
+    for ( size_t j = 0; j < _count_stride; ++j ) counts[j] += other_counts[j];
+    _arenas[into].inertia += _arenas[from].inertia;
+    _arenas[into].changed += _arenas[from].changed;
+    _arenas[into].computed += _arenas[from].computed;
+}
+
+template<typename T>
+const typename BasicKmeans<T>::Arena& BasicKmeans<T>::reduceArenas(ThreadPool &pool) {
+    /*
+     * pairwise tree over the arenas of the current epoch: every level adds
+     * arena i + step into arena i, pairs in parallel. the totals end in arena 0.
+     * numa fits on several nodes merge each node into its first worker's arena
+     * on that node, then the nodes into arena 0.
+     * returns arena 0 with the totals.
+     */
+    const size_t slots = _arenas.size();
+
+    if ( !_bounds.empty() && pool.numNodes() > 1 ) {
+        const size_t workers = pool.numThreads();
+        pool.forEachWorker([this, &pool, workers](const size_t w) {
+            if ( w > 0 && pool.nodeOf(w - 1) == pool.nodeOf(w) ) return;
+            for ( size_t v = w + 1; v < workers && pool.nodeOf(v) == pool.nodeOf(w); ++v ) mergeArena(w, v);
+        });
+        for ( size_t w = 1; w < workers; ++w ) {
+            if ( pool.nodeOf(w - 1) != pool.nodeOf(w) ) mergeArena(0, w);
+        }
+    } else {
+        for ( size_t step = 1; step < slots; step *= 2 ) {
+            const size_t pairs = (slots + 2 * step - 1) / (2 * step);
+            pool.parallelFor(0, pairs, 1, [this, step, slots](const size_t first, const size_t last) {
+                for ( size_t p = first; p < last; ++p ) {
+                    const size_t into = p * 2 * step;
+                    if ( into + step < slots ) mergeArena(into, into + step);
+                }
+            });
+        }
+    }
+
+    // nothing was accumulated at all
+    if ( _arenas[0].epoch != _epoch ) {
+        std::fill_n(_arena_sums.data(), _sum_stride, 0.0);
+        std::fill_n(_arena_counts.data(), _count_stride, 0);
+        _arenas[0] = Arena{};
+        _arenas[0].epoch = _epoch;
+    }
+    return _arenas[0];
+}
 
+template<typename T>
+bool BasicKmeans<T>::moveCenters(const double* total_sums, const size_t* cluster_counts, IterationMetrics* metrics) {
+    /*
+     * centers become the mean of their points.
+     * returns true if any center moved. `metrics`, when set, receives how far they moved.
+     */
+    const size_t dims = _point_dimensions;
+    bool moved = false;
 
-    //-- update centers
-    std::vector<Point> new_centers(_k);
-    for ( size_t cluster_id = 0; cluster_id < _k; ++cluster_id ) {
+    for ( size_t cluster_id = 0; cluster_id < static_cast<size_t>(_k); ++cluster_id ) {
 
         if ( cluster_counts[cluster_id] == 0) {
             // no point is near this center.
             // keep its position
-            new_centers[cluster_id] = _centers[cluster_id];
             continue;
         }
 
         // compute the average of the coordinates
-        for ( size_t d = 0 ; d < _point_dimensions; ++d) {
-            total_sums[cluster_id][d] /=cluster_counts[cluster_id];
+        double shift = 0.0;
+        for ( size_t d = 0 ; d < dims; ++d) {
+            const auto mean = static_cast<T>(total_sums[cluster_id * dims + d] / static_cast<double>(cluster_counts[cluster_id]));
+            if ( metrics ) {
+                const double step = static_cast<double>(mean) - static_cast<double>(_centers[cluster_id * dims + d]);
+                shift += step * step;
+            }
+            moved |= mean != _centers[cluster_id * dims + d];
+            _centers[cluster_id * dims + d] = mean;
         }
 
-        // create
-        new_centers[cluster_id] = Point(total_sums[cluster_id]);
+        if ( metrics ) {
+            metrics->max_shift = std::max(metrics->max_shift, std::sqrt(shift));
+            metrics->total_shift += std::sqrt(shift);
+        }
     }
 
-    // update centers
-    _centers = new_centers;
+    return moved;
+}
+
+template<typename T>
+size_t BasicKmeans<T>::reseedEmpty(const BasicDataset<T> &points, ThreadPool &pool) {
+    /*
+     * every cluster without points takes one of the points farthest from
+     * their own center: its sums become that point and the point leaves the
+     * sums of its old cluster, so the update puts the new center right on it
+     * and splits the cluster it came from. labels stay, the next assignment
+     * moves the point. the candidates come from a parallel top-m pass over
+     * the rows, which only runs on iterations that left a cluster empty.
+     */
+    const size_t dims = _point_dimensions;
+    double* const sums = _arena_sums.data();
+    size_t* const counts = _arena_counts.data();
+
+    std::vector<size_t> empty;
+    for ( size_t cluster_id = 0; cluster_id < static_cast<size_t>(_k); ++cluster_id ) {
+        if ( counts[cluster_id] == 0 ) empty.push_back(cluster_id);
+    }
+    if ( empty.empty() ) return 0;
+
+    // spares for points that cannot leave their cluster. farthest first, ties by row
+    const size_t wanted = std::min(points.rows(), 2 * empty.size());
+    using Candidate = std::pair<double, size_t>;
+    const auto farther = [](const Candidate& a, const Candidate& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+
+    auto candidates = pool.parallelReduce(size_t{0}, points.rows(), grainSize(points.rows(), pool), std::vector<Candidate>{},
+        [this, &points, dims, wanted, &farther](const size_t start, const size_t end) {
+            // heap whose front is the closest of the kept points
+            std::vector<Candidate> heap;
+            heap.reserve(wanted);
+            for ( size_t i = start; i < end; ++i ) {
+                const Candidate candidate{_kernels.squaredL2(points.row(i).data(), _centers.data() + points.label(i) * dims), i};
+                if ( heap.size() < wanted ) {
+                    heap.push_back(candidate);
+                    std::ranges::push_heap(heap, farther);
+                }
+                else if ( farther(candidate, heap.front()) ) {
+                    std::ranges::pop_heap(heap, farther);
+                    heap.back() = candidate;
+                    std::ranges::push_heap(heap, farther);
+                }
+            }
+            return heap;
+        },
+        [wanted, &farther](std::vector<Candidate> kept, const std::vector<Candidate>& other) {
+            kept.insert(kept.end(), other.begin(), other.end());
+            if ( kept.size() > wanted ) {
+                std::ranges::nth_element(kept, kept.begin() + static_cast<std::ptrdiff_t>(wanted), farther);
+                kept.resize(wanted);
+            }
+            return kept;
+        });
+    std::ranges::sort(candidates, farther);
+
+    size_t reseeded = 0;
+    auto next = candidates.begin();
+    for ( const size_t cluster_id : empty ) {
+        // a point on its center, or the last of its cluster, would only move the hole
+        while ( next != candidates.end() && (next->first == 0.0 || counts[points.label(next->second)] < 2) ) ++next;
+        if ( next == candidates.end() ) break;
 
+        const size_t from = points.label(next->second);
+        const T* x = points.row(next->second).data();
+        for ( size_t d = 0; d < dims; ++d ) {
+            sums[from * dims + d] -= static_cast<double>(x[d]);
+            sums[cluster_id * dims + d] = static_cast<double>(x[d]);
+        }
+        --counts[from];
+        counts[cluster_id] = 1;
+        ++reseeded;
+        ++next;
+    }
+    return reseeded;
+}
+
+template<typename T>
+void BasicKmeans<T>::observe(IterationObserver observer) {
+    _observer = std::move(observer);
+}
+
+template<typename T>
+double BasicKmeans<T>::millisSinceStart() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _fit_start).count();
+}
+
+template<typename T>
+void BasicKmeans<T>::startIteration(IterationMetrics &metrics, const int iteration) {
+    metrics.iteration = iteration;
+    metrics.start_ms = millisSinceStart();
+    if ( _observer ) std::ranges::fill(_loads, Load{});
+}
+
+template<typename T>
+void BasicKmeans<T>::finishIteration(IterationMetrics &metrics) {
+    if ( !_observer ) return;
+    metrics.workers.reserve(_loads.size());
+    for ( const Load& load : _loads ) metrics.workers.push_back(load.worker);
+    _observer(metrics);
 }
+
+template<typename T>
+bool BasicKmeans<T>::settled(const IterationMetrics &metrics, const size_t rows, const double previous_inertia) const {
+    // a reseeded iteration moved centers on purpose, it must not count as settled
+    if ( metrics.reseeded > 0 ) return false;
+
+    // boundary points that keep swapping centers would otherwise run the fit to max_iterations
+    if ( _config.tolerance > 0.0 && metrics.max_shift <= _config.tolerance ) return true;
+    if ( _config.moved_fraction > 0.0 && rows > 0 &&
+         static_cast<double>(metrics.changed) <= _config.moved_fraction * static_cast<double>(rows) ) return true;
+    if ( _config.inertia_tolerance > 0.0 && previous_inertia > 0.0 &&
+         std::abs(previous_inertia - metrics.inertia) <= _config.inertia_tolerance * previous_inertia ) return true;
+    return false;
+}
+
+template class BasicKmeans<float>;
+template class BasicKmeans<double>;
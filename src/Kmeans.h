@@ -5,28 +5,180 @@
 #ifndef KMEANS_H
 #define KMEANS_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <random>
+#include <span>
+
+#include "AlignedAllocator.h"
+#include "Checkpoint.h"
+#include "ChunkReader.h"
+#include "Dataset.h"
+#include "Distance.h"
+#include "FitMetrics.h"
+#include "GemmAssigner.h"
+#include "IvfAssigner.h"
+#include "KmeansConfig.h"
 #include "Point.h"
+#include "PrunedAssigner.h"
 #include "ThreadPool.h"
+#include "Transport.h"
 #include "vector"
 
-class Kmeans {
+/*
+ * lloyd and mini-batch k-means. T is the storage and distance scalar of points
+ * and centers, float or double. sums, counts and inertia are always double.
+ */
+template<typename T = double>
+class BasicKmeans {
 
     int _k;
     int _max_iterations;
-    std::vector<Point> _centers;
+    AlignedVector<T> _centers;          // k x dimensions, row-major
     int _point_dimensions;
+    Distance::Kernels<T> _kernels;      // distance and accumulation loops for _point_dimensions
+    Assignment _assignment;             // resolved, never Auto or Pruned
+    std::optional<GemmAssigner<T>> _gemm;   // set for Assignment::Gemm
+    std::optional<PrunedAssigner<T>> _pruned; // set for Hamerly and Elkan, sized on fit
+    std::optional<IvfAssigner<T>> _ivf;     // set for Assignment::Ivf
+    std::vector<size_t> _pruned_history;   // skipped distance computations per iteration
+    size_t _iterations = 0;             // of the last fit, steps for mini-batch
+    KmeansConfig _config;
+
+    //-- fused assign and accumulate pass, state kept between iterations
+    struct alignas(64) Arena {
+        double inertia = 0.0;
+        uint64_t epoch = 0;             // arena holds data of this epoch only
+        size_t changed = 0;             // labels that changed
+        size_t computed = 0;            // distances evaluated
+    };
+    std::vector<Arena> _arenas;         // one per pool thread plus the caller
+    AlignedVector<double> _arena_sums;  // arenas x _sum_stride, k x dimensions used
+    AlignedVector<size_t> _arena_counts;// arenas x _count_stride, k used
+    size_t _sum_stride = 0;             // both strides are whole cache lines
+    size_t _count_stride = 0;
+    uint64_t _epoch = 0;
+    std::vector<size_t> _bounds;        // numa: rows [_bounds[w], _bounds[w + 1]) belong to worker w
+    BasicDataset<T> _converted;         // streamed chunk in T, reused between chunks
+
+    //-- instrumentation, only collected while an observer is set
+    struct alignas(64) Load {
+        IterationMetrics::Worker worker;
+    };
+    IterationObserver _observer;
+    std::vector<Load> _loads;           // one per arena slot, reset every iteration
+    std::chrono::steady_clock::time_point _fit_start;
 
 
 public:
-    Kmeans(int k, int dimensions, int max_iterations);
-    void fit(std::vector<Point> &points, ThreadPool &pool);
+    using value_type = T;
+
+    // above this k * dimensions the tiled matrix product beats the per point scan
+    static constexpr int GEMM_THRESHOLD = 2048;
+    // from this k on, Elkan's per center bounds prune more than Hamerly's single one
+    static constexpr int ELKAN_MIN_K = 32;
+    // parallel loops are cut in this many chunks per pool thread
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+    // batches below this many rows are predicted without the pool
+    static constexpr size_t PARALLEL_PREDICT_ROWS = 4096;
+
+    // receives the labels of rows [first_row, first_row + labels.size()) of a streamed file
+    using LabelSink = std::function<void(size_t first_row, std::span<const int> labels)>;
+
+    BasicKmeans(int k, int dimensions, int max_iterations, KmeansConfig config = {});
+    // with KmeansConfig::numa the values of `points` may move to node local memory, unless it is a shared view
+    void fit(BasicDataset<T> &points, ThreadPool &pool);
+    // out of core: every pass streams the file chunk by chunk, labels go to `sink` at the end
+    void fit(ChunkReader &reader, ThreadPool &pool, const LabelSink &sink = {});
+    /*
+     * data parallel full batch fit: every rank of `transport` calls this with
+     * its own shard and the same k, dimensions and config. only the k x d sums
+     * and k counts travel each iteration. rank 0 seeds from its shard, every
+     * rank ends with the same centers and labels for its own rows.
+     */
+    void fit(BasicDataset<T> &shard, ThreadPool &pool, Transport &transport);
+    // centers, counts, labels and row hashes of `points` as labelled by the last fit
+    [[nodiscard]] Checkpoint checkpoint(const BasicDataset<T> &points, ThreadPool &pool) const;
+    /*
+     * warm start from a checkpoint of an earlier version of `points`. row i is
+     * the same row as in the checkpoint while its values hash the same; rows
+     * that changed or were added are assigned first, and only the centers that
+     * lost or gained rows move before the usual iterations continue.
+     */
+    void resume(BasicDataset<T> &points, ThreadPool &pool, const Checkpoint &checkpoint);
     [[nodiscard]] std::vector<Point> centers()const;
+    [[nodiscard]] Assignment assignment() const;
+    /*
+     * called after every iteration of full batch fits, in memory, streamed or
+     * distributed. distributed fits count changed, computed and inertia over
+     * all ranks, the timings are this rank's. streamed fits keep no labels
+     * between passes and report no changed points; mini-batch steps are not
+     * reported. an empty observer turns the per worker timing and the inertia
+     * of every iteration off again.
+     */
+    void observe(IterationObserver observer);
+    // distance computations skipped in each iteration of the last fit
+    [[nodiscard]] const std::vector<size_t>& prunedDistances() const;
+    // lloyd iterations of the last fit; mini-batch fits count their steps, one per batch or chunk
+    [[nodiscard]] size_t iterations() const;
+    // sum of squared distances of every point to the center it is labelled with
+    [[nodiscard]] double inertia(const BasicDataset<T> &points, ThreadPool &pool) const;
+    // share of rows labelled with their exact closest center, below 1 only for approximate assignment
+    [[nodiscard]] double agreement(const BasicDataset<T> &points, ThreadPool &pool) const;
+
+    /*
+     * closest center of new points with the fitted centers. const and safe to
+     * call from any number of threads at once; past a thread's first batch
+     * nothing is allocated per call. `points` is row-major, rows x dimensions.
+     * `distances`, when not empty, receives the squared distance of every row
+     * to its center. a batch gives every row the label and distance predict does.
+     */
+    [[nodiscard]] int predict(std::span<const T> point, T* distance = nullptr) const;
+    void predictBatch(std::span<const T> points, std::span<int> labels, std::span<T> distances = {}) const;
+    // large batches are cut in chunks over the pool, smaller ones run on the calling thread
+    void predictBatch(std::span<const T> points, std::span<int> labels, ThreadPool &pool, std::span<T> distances = {}) const;
 
 private:
-    [[nodiscard]] size_t findClosestCluster(const Point &point) const;
-    void updateCenters(const std::vector<Point> &points, ThreadPool &pool);
+    [[nodiscard]] std::span<const T> center(size_t i) const;
+    [[nodiscard]] size_t findClosestCluster(std::span<const T> point) const;
+    void predictRange(const T* points, size_t rows, int* labels, T* distances) const;
+    // engines that keep their own copy of the centers get the final ones, for predict
+    void publishCenters();
+    [[nodiscard]] static size_t grainSize(size_t rows, const ThreadPool &pool);
+    void seed(const BasicDataset<T> &points, ThreadPool &pool, std::mt19937 &gen);
+    bool assignPoints(BasicDataset<T> &points, ThreadPool &pool, size_t &computed);
+    size_t assignRange(BasicDataset<T> &points, size_t start, size_t end, size_t &changed);
+    void prepareArenas(const ThreadPool &pool);
+    void placePartitions(BasicDataset<T> &points, ThreadPool &pool);
+    template<typename F>
+    void forEachRange(const BasicDataset<T> &points, ThreadPool &pool, F &&fn);
+    void accumulateRange(BasicDataset<T> &points, size_t start, size_t end, size_t slot, bool with_inertia);
+    void addRange(const BasicDataset<T> &points, size_t start, size_t end, size_t slot, bool with_inertia);
+    void assignAndAccumulate(BasicDataset<T> &points, ThreadPool &pool, bool with_inertia);
+    void mergeArena(size_t into, size_t from);
+    const Arena& reduceArenas(ThreadPool &pool);
+    // the streamed chunk as BasicDataset<T>, converted into _converted unless T is double
+    BasicDataset<T>& typed(Dataset &chunk);
+    // the lloyd iterations of a full batch fit from the current centers
+    void iterate(BasicDataset<T> &points, ThreadPool &pool);
+    // `seen`: points each center has absorbed before, all zero when empty
+    void fitMiniBatch(BasicDataset<T> &points, ThreadPool &pool, std::mt19937 &gen, std::vector<size_t> seen = {});
+    bool moveCenters(const double* total_sums, const size_t* cluster_counts, IterationMetrics* metrics = nullptr);
+    // hands every empty cluster in the reduced arena one of the farthest points, returns how many got one
+    size_t reseedEmpty(const BasicDataset<T> &points, ThreadPool &pool);
+    [[nodiscard]] double millisSinceStart() const;
+    void startIteration(IterationMetrics &metrics, int iteration);
+    void finishIteration(IterationMetrics &metrics);
+    // true if one of the tolerances of the config is met
+    [[nodiscard]] bool settled(const IterationMetrics &metrics, size_t rows, double previous_inertia) const;
 };
 
+extern template class BasicKmeans<float>;
+extern template class BasicKmeans<double>;
 
+using Kmeans = BasicKmeans<>;
 
 #endif //KMEANS_H
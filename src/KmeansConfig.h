@@ -0,0 +1,68 @@
+#ifndef KMEANSCONFIG_H
+#define KMEANSCONFIG_H
+
+#include <cstddef>
+#include <optional>
+
+// how points are matched to their closest center each iteration
+enum class Assignment {
+    Auto,       // Gemm when k * dimensions >= Kmeans::GEMM_THRESHOLD, Direct otherwise
+    Direct,     // simd scan of every center for every point
+    Gemm,       // tiled matrix product, see GemmAssigner
+    Pruned,     // Hamerly when k < Kmeans::ELKAN_MIN_K, Elkan otherwise
+    Hamerly,    // one lower bound per point
+    Elkan,      // k lower bounds per point
+    Ivf,        // approximate: inverted file over the centers, see IvfAssigner
+};
+
+enum class Mode {
+    FullBatch,  // lloyd: every iteration visits every point
+    MiniBatch,  // every step visits a random batch, see KmeansConfig::batch_size
+};
+
+// how the first k centers are chosen, see Seeding
+enum class Initialization {
+    Random,         // k distinct rows
+    KmeansPlusPlus, // D^2 sampling, k passes over the data
+    KmeansParallel, // k-means||, a few oversampling passes then k-means++ on the sample
+};
+
+struct KmeansConfig {
+    Assignment assignment = Assignment::Auto;
+    Mode mode = Mode::FullBatch;
+    Initialization initialization = Initialization::KmeansPlusPlus;
+    std::optional<unsigned> seed;   // fixed seed for reproducible fits, random when empty
+    bool verbose = true;            // report early stops on stdout
+
+    //-- full batch stopping rules on top of no label changing, 0 turns a rule
+    //-- off. checked after every iteration, the first rule met stops the fit
+    double tolerance = 0.0;         // largest distance any center moved
+    double inertia_tolerance = 0.0; // inertia change relative to the iteration before
+    double moved_fraction = 0.0;    // share of points whose label changed
+
+    //-- full batch fits of in-memory data on one process. a cluster left
+    //-- without points takes the point farthest from its own center instead
+    //-- of keeping its place, where it costs a distance per point for nothing
+    bool reseed_empty = true;
+
+    //-- full batch fits of in-memory data only. every pool worker gets a fixed
+    //-- row range whose values it places in its own numa node's memory, and
+    //-- sums are merged per node first. meant for a pinned ThreadPool
+    bool numa = false;
+
+    //-- Assignment::Ivf only. more probes give labels closer to the exact
+    //-- scan and cost more, see Kmeans::agreement
+    size_t ivf_lists = 0;           // groups of centers, 0 for about sqrt(k)
+    size_t ivf_probes = 8;          // groups scanned per point
+
+    //-- k-means|| only
+    int parallel_rounds = 5;
+    double oversampling = 2.0;      // points kept per round, as a multiple of k
+
+    //-- mini-batch only. max_iterations counts passes over the data,
+    //-- so at most max_iterations * rows / batch_size steps are taken
+    size_t batch_size = 1024;
+    int max_no_improvement = 10;    // steps without a better smoothed inertia before stopping
+};
+
+#endif // KMEANSCONFIG_H
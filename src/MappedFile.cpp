@@ -0,0 +1,48 @@
+#include "MappedFile.h"
+
+#include <format>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(std::string path, const bool copy_on_write) : _path(std::move(path)), _writable(copy_on_write) {
+    const int fd = ::open(_path.c_str(), O_RDONLY);
+    if ( fd < 0 ) throw std::runtime_error(std::format("[ERROR] Could not open file: {}", _path));
+
+    struct stat info{};
+    if ( ::fstat(fd, &info) != 0 ) {
+        ::close(fd);
+        throw std::runtime_error(std::format("[ERROR] Could not stat file: {}", _path));
+    }
+    _size = static_cast<size_t>(info.st_size);
+
+    if ( _size > 0 ) {
+        const int protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* mapped = ::mmap(nullptr, _size, protection, MAP_PRIVATE, fd, 0);
+        if ( mapped == MAP_FAILED ) {
+            ::close(fd);
+            throw std::runtime_error(std::format("[ERROR] Could not map file: {}", _path));
+        }
+        ::madvise(mapped, _size, MADV_SEQUENTIAL);
+        _data = static_cast<char*>(mapped);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if ( _data ) ::munmap(_data, _size);
+}
+
+const char* MappedFile::data() const { return _data; }
+
+char* MappedFile::mutableData() {
+    if ( !_writable ) throw std::logic_error(std::format("[ERROR] File is mapped read-only: {}", _path));
+    return _data;
+}
+size_t MappedFile::size() const { return _size; }
+std::string_view MappedFile::view() const { return {_data, _size}; }
+const std::string& MappedFile::path() const { return _path; }
@@ -0,0 +1,31 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// memory mapping of a whole file, unmapped on destruction.
+// private mappings can be written to; the changes never reach the file.
+class MappedFile {
+    std::string _path;
+    char* _data = nullptr;
+    size_t _size = 0;
+    bool _writable = false;
+
+public:
+    explicit MappedFile(std::string path, bool copy_on_write = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // getters
+    [[nodiscard]] const char* data() const;
+    [[nodiscard]] char* mutableData();     // only for copy_on_write mappings
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] std::string_view view() const;
+    [[nodiscard]] const std::string& path() const;
+};
+
+#endif // MAPPEDFILE_H
@@ -10,7 +10,7 @@ Point::Point(std::vector<double> cords) {
     this->_cluster = -1;
 }
 
-std::vector<double> Point::cords() const { return  this->_cords;}
+const std::vector<double>& Point::cords() const { return  this->_cords;}
 int Point::cluster() const { return this->_cluster; }
 
 void Point::setCluster(const int c) {
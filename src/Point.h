@@ -17,7 +17,7 @@ class Point {
 
         explicit Point(std::vector<double> cords);
         // getters
-        [[nodiscard]] std::vector<double> cords() const;
+        [[nodiscard]] const std::vector<double>& cords() const;
         [[nodiscard]] int cluster() const;
         void setCluster(int c);
 
@@ -0,0 +1,223 @@
+#include "PrunedAssigner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Distance.h"
+
+namespace {
+
+// bounds drift by a few ulps per iteration. a point is only skipped when the
+// proof holds with this much room, so labels match a full scan exactly.
+// single precision distances carry a much larger rounding error.
+template<typename T>
+constexpr double SLACK = std::is_same_v<T, float> ? 1.0 + 1e-4 : 1.0 + 1e-10;
+
+constexpr size_t BLOCK = 8;
+
+// bounds are kept in double whatever the scalar of the points
+double root(const double squared) { return std::sqrt(squared); }
+
+} // namespace
+
+template<typename T>
+PrunedAssigner<T>::PrunedAssigner(const Method method, const size_t rows, const size_t k, const size_t dimensions) :
+                _method(method),
+                _rows(rows),
+                _k(k),
+                _dimensions(dimensions),
+                _kernels(Distance::kernels<T>(dimensions)),
+                _shift(k, 0.0),
+                _halfGap(k, 0.0),
+                _upper(rows, 0.0),
+                _lower(method == Method::Elkan ? rows * k : rows, 0.0)
+{
+    if ( k < 2 ) throw std::invalid_argument("[ERROR] Pruned assignment needs at least two clusters.");
+    if ( method == Method::Elkan ) _centerDistances.resize(k * k, 0.0);
+}
+
+template<typename T>
+typename PrunedAssigner<T>::Method PrunedAssigner<T>::method() const { return _method; }
+
+template<typename T>
+void PrunedAssigner<T>::setCenters(const T* centers) {
+    const size_t d = _dimensions;
+    _centers = centers;
+
+    //-- how far each center moved since the last call
+    _maxShift = _secondShift = 0.0;
+    if ( _previous.empty() ) {
+        _previous.assign(centers, centers + _k * d);
+    }
+    else {
+        _initialized = true;
+        for ( size_t c = 0; c < _k; ++c ) {
+            _shift[c] = root(_kernels.squaredL2(_previous.data() + c * d, centers + c * d));
+
+            if ( _shift[c] > _maxShift ) {
+                _secondShift = _maxShift;
+                _maxShift = _shift[c];
+            }
+            else if ( _shift[c] > _secondShift ) {
+                _secondShift = _shift[c];
+            }
+        }
+        std::copy_n(centers, _k * d, _previous.begin());
+    }
+
+    //-- half distances between centers, elkan keeps the pairs where neither center moved
+    const bool reuse = _method == Method::Elkan && _initialized;
+    std::ranges::fill(_halfGap, std::numeric_limits<double>::infinity());
+    for ( size_t a = 0; a < _k; ++a ) {
+        for ( size_t b = a + 1; b < _k; ++b ) {
+            const double half = reuse && _shift[a] == 0.0 && _shift[b] == 0.0
+                                    ? _centerDistances[a * _k + b]
+                                    : 0.5 * root(_kernels.squaredL2(centers + a * d, centers + b * d));
+            _halfGap[a] = std::min(_halfGap[a], half);
+            _halfGap[b] = std::min(_halfGap[b], half);
+
+            if ( _method == Method::Elkan ) {
+                _centerDistances[a * _k + b] = half;
+                _centerDistances[b * _k + a] = half;
+            }
+        }
+    }
+}
+
+template<typename T>
+size_t PrunedAssigner<T>::assign(const T* points, const size_t begin, const size_t end, int* labels, size_t& computed) {
+    size_t changed = 0;
+    computed = 0;
+
+    for ( size_t i = begin; i < end; ++i ) {
+        const T* x = points + i * _dimensions;
+        const int before = labels[i];
+
+        size_t row_computed;
+        if ( !_initialized || before < 0 ) row_computed = initialize(x, i, labels[i]);
+        else if ( _method == Method::Hamerly ) row_computed = hamerly(x, i, labels[i]);
+        else row_computed = elkan(x, i, labels[i]);
+        computed += std::min(row_computed, _k);
+
+        if ( labels[i] != before ) ++changed;
+    }
+
+    return changed;
+}
+
+template<typename T>
+size_t PrunedAssigner<T>::initialize(const T* x, const size_t i, int& label) {
+    /*
+     * full scan with the same kernel and tie rule as Distance::argmin,
+     * filling the bounds on the way.
+     */
+    T scores[BLOCK];
+    T best = std::numeric_limits<T>::infinity();
+    T second = std::numeric_limits<T>::infinity();
+    size_t closest = 0;
+
+    for ( size_t c = 0; c < _k; c += BLOCK ) {
+        const size_t count = std::min(BLOCK, _k - c);
+        _kernels.squaredL2Block(x, _centers + c * _dimensions, count, scores);
+
+        for ( size_t j = 0; j < count; ++j ) {
+            if ( _method == Method::Elkan ) _lower[i * _k + c + j] = root(scores[j]);
+
+            if ( scores[j] < best ) {
+                second = best;
+                best = scores[j];
+                closest = c + j;
+            }
+            else if ( scores[j] < second ) {
+                second = scores[j];
+            }
+        }
+    }
+
+    label = static_cast<int>(closest);
+    _upper[i] = root(best);
+    if ( _method == Method::Hamerly ) _lower[i] = root(second);
+    return _k;
+}
+
+template<typename T>
+size_t PrunedAssigner<T>::hamerly(const T* x, const size_t i, int& label) {
+    const size_t a = label;
+
+    // loosen the bounds by how far the centers moved
+    double upper = _upper[i] + _shift[a];
+    const double lower = _lower[i] - (_shift[a] == _maxShift ? _secondShift : _maxShift);
+    const double bound = std::max(_halfGap[a], lower);
+
+    if ( upper * SLACK<T> < bound ) {
+        _upper[i] = upper;
+        _lower[i] = lower;
+        return 0;
+    }
+
+    // tighten the upper bound and try again
+    upper = root(_kernels.squaredL2(x, _centers + a * _dimensions));
+    if ( upper * SLACK<T> < bound ) {
+        _upper[i] = upper;
+        _lower[i] = lower;
+        return 1;
+    }
+
+    return 1 + initialize(x, i, label);
+}
+
+template<typename T>
+size_t PrunedAssigner<T>::elkan(const T* x, const size_t i, int& label) {
+    size_t a = label;
+    double* lower = _lower.data() + i * _k;
+    size_t computed = 0;
+
+    // loosen the bounds by how far the centers moved
+    double upper = _upper[i] + _shift[a];
+    for ( size_t j = 0; j < _k; ++j ) lower[j] = std::max(0.0, lower[j] - _shift[j]);
+
+    if ( upper * SLACK<T> < _halfGap[a] ) {
+        _upper[i] = upper;
+        return 0;
+    }
+
+    bool tight = false;
+    double upperSq = 0.0;
+
+    for ( size_t j = 0; j < _k; ++j ) {
+        if ( j == a ) continue;
+
+        const double bound = std::max(lower[j], _centerDistances[a * _k + j]);
+        if ( upper * SLACK<T> < bound ) continue;
+
+        if ( !tight ) {
+            upperSq = _kernels.squaredL2(x, _centers + a * _dimensions);
+            upper = std::sqrt(upperSq);
+            lower[a] = upper;
+            tight = true;
+            ++computed;
+            if ( upper * SLACK<T> < bound ) continue;
+        }
+
+        const double distanceSq = _kernels.squaredL2(x, _centers + j * _dimensions);
+        lower[j] = std::sqrt(distanceSq);
+        ++computed;
+
+        // same tie rule as a full scan: lower index wins
+        if ( distanceSq < upperSq || ( distanceSq == upperSq && j < a ) ) {
+            a = j;
+            upperSq = distanceSq;
+            upper = lower[j];
+        }
+    }
+
+    label = static_cast<int>(a);
+    _upper[i] = upper;
+    return computed;
+}
+
+template class PrunedAssigner<float>;
+template class PrunedAssigner<double>;
@@ -0,0 +1,67 @@
+#ifndef PRUNEDASSIGNER_H
+#define PRUNEDASSIGNER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Distance.h"
+
+/*
+ * exact assignment that skips distance computations with the triangle inequality.
+ * every point keeps an upper bound on the distance to its center and lower
+ * bounds on the distance to the others; after a center update the bounds are
+ * loosened by how far the centers moved. a point is only looked at again when
+ * its bounds can no longer prove its label.
+ *
+ * Hamerly keeps one lower bound per point (to the second closest center),
+ * Elkan keeps one per center and uses all center-center distances.
+ * points and centers are T, float or double; bounds are always double.
+ */
+template<typename T>
+class PrunedAssigner {
+public:
+    enum class Method { Hamerly, Elkan };
+
+    PrunedAssigner(Method method, size_t rows, size_t k, size_t dimensions);
+
+    // records how far each center moved and the center-center distances.
+    // call after every center update, before assign.
+    void setCenters(const T* centers);
+
+    // assigns rows [begin, end). labels are updated in place, returns how many changed.
+    // `computed` receives the distances evaluated, at most k per row: a hamerly rescan
+    // also tightened the bound to the old center, that extra one is not counted,
+    // so rows * k - computed is what the bounds saved.
+    // disjoint ranges can run on different threads.
+    size_t assign(const T* points, size_t begin, size_t end, int* labels, size_t& computed);
+
+    [[nodiscard]] Method method() const;
+
+private:
+    Method _method;
+    size_t _rows;
+    size_t _k;
+    size_t _dimensions;
+    Distance::Kernels<T> _kernels;      // bound to _dimensions
+    bool _initialized = false;
+
+    const T* _centers = nullptr;
+    std::vector<T> _previous;           // centers of the last iteration
+    std::vector<double> _shift;         // distance each center moved
+    double _maxShift = 0.0;
+    double _secondShift = 0.0;
+    std::vector<double> _halfGap;       // half distance to the closest other center
+    std::vector<double> _centerDistances; // k x k, elkan only
+
+    std::vector<double> _upper;         // per point
+    std::vector<double> _lower;         // per point (hamerly) or per point and center (elkan)
+
+    size_t initialize(const T* x, size_t i, int& label);
+    size_t hamerly(const T* x, size_t i, int& label);
+    size_t elkan(const T* x, size_t i, int& label);
+};
+
+extern template class PrunedAssigner<float>;
+extern template class PrunedAssigner<double>;
+
+#endif // PRUNEDASSIGNER_H
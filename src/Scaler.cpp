@@ -0,0 +1,139 @@
+#include "Scaler.h"
+
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// spreads of constant columns: min-max keeps its old epsilon, the others divide by one
+constexpr double MIN_MAX_EPSILON = 1e-6;
+
+void checkDimensions(const Scaler& scaler, const size_t dimensions) {
+    if ( dimensions != scaler.dimensions() ) {
+        throw std::invalid_argument(std::format("[ERROR] Scaler was fitted on {} columns, got {}.",
+                                                scaler.dimensions(), dimensions));
+    }
+}
+
+} // namespace
+
+size_t Scaler::dimensions() const { return center.size(); }
+
+Scaler Scaler::fit(const ColumnStats& stats, const Scaling scaling) {
+    const size_t dims = stats.dimensions();
+    Scaler scaler;
+    scaler.scaling = scaling;
+    scaler.center.resize(dims);
+    scaler.spread.resize(dims);
+
+    for ( size_t c = 0; c < dims; ++c ) {
+        switch ( scaling ) {
+            case Scaling::MinMax:
+                scaler.center[c] = stats.min[c];
+                scaler.spread[c] = stats.max[c] - stats.min[c];
+                if ( scaler.spread[c] == 0 ) scaler.spread[c] += MIN_MAX_EPSILON;
+                break;
+            case Scaling::ZScore:
+                scaler.center[c] = stats.mean[c];
+                scaler.spread[c] = stats.stddev(c);
+                if ( scaler.spread[c] == 0 ) scaler.spread[c] = 1.0;
+                break;
+            case Scaling::Robust:
+                scaler.center[c] = stats.quantile(c, 0.5);
+                scaler.spread[c] = stats.quantile(c, 0.75) - stats.quantile(c, 0.25);
+                if ( scaler.spread[c] == 0 ) scaler.spread[c] = 1.0;
+                break;
+        }
+    }
+    return scaler;
+}
+
+Scaler Scaler::fit(const Dataset& data, const Scaling scaling, ThreadPool& pool) {
+    return fit(ColumnStats::compute(data, pool, scaling == Scaling::Robust), scaling);
+}
+
+template<typename T>
+void Scaler::transform(BasicDataset<T>& data, ThreadPool& pool) const {
+    checkDimensions(*this, data.dimensions());
+    pool.parallelFor(0, data.rows(), ColumnStats::CHUNK_ROWS, [this, &data](const size_t begin, const size_t end) {
+        for ( size_t i = begin; i < end; ++i ) transform(data.row(i));
+    });
+}
+
+template<typename T>
+void Scaler::transform(const std::span<T> row) const {
+    checkDimensions(*this, row.size());
+    for ( size_t c = 0; c < row.size(); ++c ) {
+        row[c] = static_cast<T>((static_cast<double>(row[c]) - center[c]) / spread[c]);
+    }
+}
+
+template<typename T>
+void Scaler::inverse(const std::span<T> row) const {
+    checkDimensions(*this, row.size());
+    for ( size_t c = 0; c < row.size(); ++c ) {
+        row[c] = static_cast<T>(static_cast<double>(row[c]) * spread[c] + center[c]);
+    }
+}
+
+void Scaler::save(const std::string& path) const {
+    if ( spread.size() != center.size() ) throw std::invalid_argument("[ERROR] Scaler parts do not match in size.");
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.version = VERSION;
+    header.scaling = static_cast<uint32_t>(scaling);
+    header.dimensions = dimensions();
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if ( !out.is_open() ) throw std::runtime_error(std::format("[ERROR] Could not create file: {}", temporary));
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof header);
+        out.write(reinterpret_cast<const char*>(center.data()), static_cast<std::streamsize>(center.size() * sizeof(double)));
+        out.write(reinterpret_cast<const char*>(spread.data()), static_cast<std::streamsize>(spread.size() * sizeof(double)));
+
+        if ( !out ) throw std::runtime_error(std::format("[ERROR] Could not write file: {}", temporary));
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+Scaler Scaler::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if ( !in.is_open() ) throw std::runtime_error(std::format("[ERROR] Could not open file: {}", path));
+
+    Header header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof header);
+    if ( !in || std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 ) {
+        throw std::runtime_error(std::format("[ERROR] Not a scaler: {}", path));
+    }
+    if ( header.version != VERSION ) {
+        throw std::runtime_error(std::format("[ERROR] Scaler version {} is not supported: {}", header.version, path));
+    }
+    if ( header.scaling > static_cast<uint32_t>(Scaling::Robust) ) {
+        throw std::runtime_error(std::format("[ERROR] Unknown scaling {}: {}", header.scaling, path));
+    }
+    if ( std::filesystem::file_size(path) != sizeof header + 2 * header.dimensions * sizeof(double) ) {
+        throw std::runtime_error(std::format("[ERROR] Scaler is truncated: {}", path));
+    }
+
+    Scaler scaler;
+    scaler.scaling = static_cast<Scaling>(header.scaling);
+    scaler.center.resize(header.dimensions);
+    scaler.spread.resize(header.dimensions);
+    in.read(reinterpret_cast<char*>(scaler.center.data()), static_cast<std::streamsize>(header.dimensions * sizeof(double)));
+    in.read(reinterpret_cast<char*>(scaler.spread.data()), static_cast<std::streamsize>(header.dimensions * sizeof(double)));
+    if ( !in ) throw std::runtime_error(std::format("[ERROR] Could not read file: {}", path));
+    return scaler;
+}
+
+template void Scaler::transform(BasicDataset<float>&, ThreadPool&) const;
+template void Scaler::transform(BasicDataset<double>&, ThreadPool&) const;
+template void Scaler::transform(std::span<float>) const;
+template void Scaler::transform(std::span<double>) const;
+template void Scaler::inverse(std::span<float>) const;
+template void Scaler::inverse(std::span<double>) const;
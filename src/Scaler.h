@@ -0,0 +1,72 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ColumnStats.h"
+#include "Dataset.h"
+#include "ThreadPool.h"
+
+// how a Scaler maps every column
+enum class Scaling {
+    MinMax,     // to [0, 1] by the column's min and max
+    ZScore,     // zero mean and unit variance
+    Robust,     // zero median, interquartile range of 1; outliers do not squash the rest
+};
+
+/*
+ * fitted per column transform: value -> (value - center) / spread. the
+ * parameters come from the training data once and are saved with it, so
+ * points given to predict later are scaled exactly like the ones the model
+ * was fitted on. constant columns get a spread that maps them to 0.
+ *
+ * file layout, all integers little endian:
+ *   Header
+ *   center      dims doubles
+ *   spread      dims doubles
+ */
+struct Scaler {
+    static constexpr char MAGIC[8] = {'K', 'M', 'S', 'C', 'A', 'L', 'E', '\0'};
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t scaling;
+        uint64_t dimensions;
+    };
+
+    Scaling scaling = Scaling::MinMax;
+    std::vector<double> center;
+    std::vector<double> spread;
+
+    [[nodiscard]] size_t dimensions() const;
+
+    // robust scaling needs statistics computed with quantiles
+    [[nodiscard]] static Scaler fit(const ColumnStats& stats, Scaling scaling);
+    [[nodiscard]] static Scaler fit(const Dataset& data, Scaling scaling, ThreadPool& pool);
+
+    // in place. rows of the dataset are scaled in parallel
+    template<typename T>
+    void transform(BasicDataset<T>& data, ThreadPool& pool) const;
+    template<typename T>
+    void transform(std::span<T> row) const;
+    // back to the original units, e.g. for centers
+    template<typename T>
+    void inverse(std::span<T> row) const;
+
+    void save(const std::string& path) const;
+    [[nodiscard]] static Scaler load(const std::string& path);
+};
+
+extern template void Scaler::transform(BasicDataset<float>&, ThreadPool&) const;
+extern template void Scaler::transform(BasicDataset<double>&, ThreadPool&) const;
+extern template void Scaler::transform(std::span<float>) const;
+extern template void Scaler::transform(std::span<double>) const;
+extern template void Scaler::inverse(std::span<float>) const;
+extern template void Scaler::inverse(std::span<double>) const;
+
+#endif // SCALER_H
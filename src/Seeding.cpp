@@ -0,0 +1,228 @@
+#include "Seeding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "Distance.h"
+
+namespace {
+
+// rows per parallel chunk. fixed so results do not depend on the thread count
+constexpr size_t CHUNK = 8192;
+
+// runs fn(chunk, begin, end) for every chunk on the pool, results in chunk order
+template<class F>
+auto forChunks(ThreadPool &pool, const size_t rows, F&& fn) {
+    using R = std::invoke_result_t<F, size_t, size_t, size_t>;
+
+    std::vector<R> results((rows + CHUNK - 1) / CHUNK);
+    pool.parallelFor(0, rows, CHUNK, [&fn, &results](const size_t begin, const size_t end) {
+        results[begin / CHUNK] = fn(begin / CHUNK, begin, end);
+    });
+    return results;
+}
+
+// lowers min_distances with a set of new centers, returns the total per chunk
+template<typename T>
+std::vector<double> updateDistances(const BasicDataset<T> &points, const T* centers, const size_t count,
+                                    std::vector<double> &min_distances, ThreadPool &pool) {
+    const size_t dims = points.dimensions();
+
+    return forChunks(pool, points.rows(), [&](size_t, const size_t begin, const size_t end) {
+        double sum = 0.0;
+        for ( size_t i = begin; i < end; ++i ) {
+            T distance;
+            static_cast<void>(Distance::argmin(points.row(i).data(), centers, count, dims, &distance));
+            min_distances[i] = std::min<double>(min_distances[i], distance);
+            sum += min_distances[i];
+        }
+        return sum;
+    });
+}
+
+// index drawn with probability weights[i] / total, using per chunk totals to skip ahead
+size_t drawWeighted(const std::vector<double> &weights, const std::vector<double> &chunk_sums, std::mt19937 &gen) {
+    const double total = std::accumulate(chunk_sums.begin(), chunk_sums.end(), 0.0);
+    if ( total <= 0.0 ) {
+        return std::uniform_int_distribution<size_t>(0, weights.size() - 1)(gen);
+    }
+
+    double target = std::uniform_real_distribution<double>(0.0, total)(gen);
+
+    size_t chunk = 0;
+    while ( chunk + 1 < chunk_sums.size() && target >= chunk_sums[chunk] ) target -= chunk_sums[chunk++];
+
+    const size_t begin = chunk * CHUNK;
+    const size_t end = std::min(begin + CHUNK, weights.size());
+    size_t last = begin;
+    for ( size_t i = begin; i < end; ++i ) {
+        if ( weights[i] <= 0.0 ) continue;
+        last = i;
+        if ( target < weights[i] ) return i;
+        target -= weights[i];
+    }
+    return last;    // rounding left target a hair above the chunk total
+}
+
+// serial weighted k-means++ over a small candidate set
+template<typename T>
+void weightedPlusPlus(const std::vector<T> &candidates, const std::vector<double> &weights, const size_t dims,
+                      const size_t k, T* centers, std::mt19937 &gen) {
+    const size_t count = weights.size();
+    std::vector<double> min_distances(count, std::numeric_limits<double>::infinity());
+    std::vector<double> scores(count);
+
+    size_t pick = std::discrete_distribution<size_t>(weights.begin(), weights.end())(gen);
+    for ( size_t c = 0; c < k; ++c ) {
+        std::copy_n(candidates.data() + pick * dims, dims, centers + c * dims);
+
+        double total = 0.0;
+        for ( size_t i = 0; i < count; ++i ) {
+            min_distances[i] = std::min<double>(min_distances[i], Distance::squaredL2(candidates.data() + i * dims, centers + c * dims, dims));
+            scores[i] = weights[i] * min_distances[i];
+            total += scores[i];
+        }
+
+        if ( total <= 0.0 ) pick = std::uniform_int_distribution<size_t>(0, count - 1)(gen);
+        else pick = std::discrete_distribution<size_t>(scores.begin(), scores.end())(gen);
+    }
+}
+
+} // namespace
+
+template<typename T>
+void Seeding::random(const BasicDataset<T> &points, const size_t k, T* centers, std::mt19937 &gen) {
+    // floyd's sampling: k draws, no O(N) index buffer
+    std::vector<size_t> seeds;
+    seeds.reserve(k);
+    for ( size_t j = points.rows() - k; j < points.rows(); ++j ) {
+        const size_t t = std::uniform_int_distribution<size_t>(0, j)(gen);
+        seeds.push_back(std::ranges::find(seeds, t) == seeds.end() ? t : j);
+    }
+
+    const size_t dims = points.dimensions();
+    for ( size_t c = 0; c < k; ++c ) {
+        std::ranges::copy(points.row(seeds[c]), centers + c * dims);
+    }
+}
+
+template<typename T>
+void Seeding::kmeansPlusPlus(const BasicDataset<T> &points, const size_t k, T* centers, ThreadPool &pool, std::mt19937 &gen) {
+    const size_t rows = points.rows();
+    const size_t dims = points.dimensions();
+
+    std::vector<double> min_distances(rows, std::numeric_limits<double>::infinity());
+
+    // first center uniformly, the rest by D^2 sampling
+    size_t pick = std::uniform_int_distribution<size_t>(0, rows - 1)(gen);
+    for ( size_t c = 0; c < k; ++c ) {
+        T* center = centers + c * dims;
+        std::ranges::copy(points.row(pick), center);
+
+        if ( c + 1 == k ) break;
+        const auto chunk_sums = updateDistances(points, center, 1, min_distances, pool);
+        pick = drawWeighted(min_distances, chunk_sums, gen);
+    }
+}
+
+template<typename T>
+void Seeding::kmeansParallel(const BasicDataset<T> &points, const size_t k, T* centers, ThreadPool &pool, std::mt19937 &gen,
+                             const int rounds, const double oversampling) {
+    if ( rounds <= 0 || oversampling <= 0 ) throw std::invalid_argument("[ERROR] k-means|| needs positive rounds and oversampling.");
+
+    const size_t rows = points.rows();
+    const size_t dims = points.dimensions();
+    const double expected = oversampling * static_cast<double>(k);   // points kept per round
+
+    std::vector<double> min_distances(rows, std::numeric_limits<double>::infinity());
+    std::vector<T> candidates;        // row-major
+    std::vector<size_t> picked;       // row of every candidate
+
+    //-- first candidate uniformly
+    const size_t first = std::uniform_int_distribution<size_t>(0, rows - 1)(gen);
+    candidates.insert(candidates.end(), points.row(first).begin(), points.row(first).end());
+    picked.push_back(first);
+    auto chunk_sums = updateDistances(points, candidates.data(), 1, min_distances, pool);
+
+    //-- oversampling rounds
+    for ( int round = 0; round < rounds; ++round ) {
+        const double total = std::accumulate(chunk_sums.begin(), chunk_sums.end(), 0.0);
+        if ( total <= 0.0 ) break;     // every point is already a candidate
+
+        // each chunk draws from its own generator, seeded from the shared one
+        const auto base = gen();
+        const auto kept = forChunks(pool, rows, [&](const size_t chunk, const size_t begin, const size_t end) {
+            std::seed_seq seq{base, static_cast<std::mt19937::result_type>(chunk)};
+            std::mt19937 local(seq);
+            std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+            std::vector<size_t> selected;
+            for ( size_t i = begin; i < end; ++i ) {
+                if ( coin(local) < expected * min_distances[i] / total ) selected.push_back(i);
+            }
+            return selected;
+        });
+
+        const size_t before = candidates.size() / dims;
+        for ( const auto& selected : kept ) {
+            for ( const size_t i : selected ) {
+                candidates.insert(candidates.end(), points.row(i).begin(), points.row(i).end());
+                picked.push_back(i);
+            }
+        }
+        const size_t added = candidates.size() / dims - before;
+        if ( added == 0 ) continue;
+
+        chunk_sums = updateDistances(points, candidates.data() + before * dims, added, min_distances, pool);
+    }
+
+    const size_t count = candidates.size() / dims;
+    if ( count <= k ) {
+        // not enough candidates to choose from, top up with distinct rows that are not candidates yet.
+        // floyd's sampling over the free rows, draw t is the t-th row missing from picked
+        std::copy_n(candidates.begin(), count * dims, centers);
+        std::ranges::sort(picked);
+        std::vector<size_t> free_draws;
+        free_draws.reserve(k - count);
+        for ( size_t j = rows - k; j < rows - count; ++j ) {
+            const size_t t = std::uniform_int_distribution<size_t>(0, j)(gen);
+            free_draws.push_back(std::ranges::find(free_draws, t) == free_draws.end() ? t : j);
+        }
+        for ( size_t c = 0; c < free_draws.size(); ++c ) {
+            size_t row = free_draws[c];
+            for ( const size_t taken : picked ) {
+                if ( taken > row ) break;
+                ++row;
+            }
+            std::ranges::copy(points.row(row), centers + (count + c) * dims);
+        }
+        return;
+    }
+
+    //-- weight every candidate by the points closest to it
+    const auto partial = forChunks(pool, rows, [&](size_t, const size_t begin, const size_t end) {
+        std::vector<double> local(count, 0.0);
+        for ( size_t i = begin; i < end; ++i ) {
+            local[Distance::argmin(points.row(i).data(), candidates.data(), count, dims)] += 1.0;
+        }
+        return local;
+    });
+    std::vector<double> weights(count, 0.0);
+    for ( const auto& local : partial ) {
+        for ( size_t c = 0; c < count; ++c ) weights[c] += local[c];
+    }
+
+    //-- recluster the candidates down to k
+    weightedPlusPlus(candidates, weights, dims, k, centers, gen);
+}
+
+template void Seeding::random(const BasicDataset<float>&, size_t, float*, std::mt19937&);
+template void Seeding::random(const BasicDataset<double>&, size_t, double*, std::mt19937&);
+template void Seeding::kmeansPlusPlus(const BasicDataset<float>&, size_t, float*, ThreadPool&, std::mt19937&);
+template void Seeding::kmeansPlusPlus(const BasicDataset<double>&, size_t, double*, ThreadPool&, std::mt19937&);
+template void Seeding::kmeansParallel(const BasicDataset<float>&, size_t, float*, ThreadPool&, std::mt19937&, int, double);
+template void Seeding::kmeansParallel(const BasicDataset<double>&, size_t, double*, ThreadPool&, std::mt19937&, int, double);
@@ -0,0 +1,34 @@
+#ifndef SEEDING_H
+#define SEEDING_H
+
+#include <cstddef>
+#include <random>
+
+#include "Dataset.h"
+#include "ThreadPool.h"
+
+/*
+ * initial centers for Kmeans. all of them write k row-major centers.
+ * work is split in fixed size chunks, not per thread, so the same generator
+ * state gives the same centers whatever the pool size.
+ * T is the scalar of points and centers, float or double.
+ */
+class Seeding {
+public:
+    // k distinct rows picked uniformly
+    template<typename T>
+    static void random(const BasicDataset<T> &points, size_t k, T* centers, std::mt19937 &gen);
+
+    // k-means++: every next center is drawn with probability proportional to
+    // its squared distance to the closest center so far (D^2 sampling)
+    template<typename T>
+    static void kmeansPlusPlus(const BasicDataset<T> &points, size_t k, T* centers, ThreadPool &pool, std::mt19937 &gen);
+
+    // k-means||: `rounds` passes that each keep every point with probability
+    // oversampling * k * D^2 / total, then weighted k-means++ over the kept points
+    template<typename T>
+    static void kmeansParallel(const BasicDataset<T> &points, size_t k, T* centers, ThreadPool &pool, std::mt19937 &gen,
+                               int rounds, double oversampling);
+};
+
+#endif // SEEDING_H
@@ -0,0 +1,183 @@
+#include "SocketTransport.h"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+// what a rank sends right after connecting
+struct Hello {
+    uint64_t rank;
+    uint64_t size;
+};
+
+sockaddr_un addressOf(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if ( path.size() >= sizeof address.sun_path ) {
+        throw std::invalid_argument(std::format("[ERROR] Socket path is too long: {}", path));
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+void sendAll(const int fd, const void* data, size_t bytes) {
+    const auto* p = static_cast<const char*>(data);
+    while ( bytes > 0 ) {
+        const ssize_t sent = ::send(fd, p, bytes, MSG_NOSIGNAL);
+        if ( sent < 0 && errno == EINTR ) continue;
+        if ( sent <= 0 ) throw std::runtime_error(std::format("[ERROR] Lost connection to a peer: {}", std::strerror(errno)));
+        p += sent;
+        bytes -= static_cast<size_t>(sent);
+    }
+}
+
+void receiveAll(const int fd, void* data, size_t bytes) {
+    auto* p = static_cast<char*>(data);
+    while ( bytes > 0 ) {
+        const ssize_t received = ::recv(fd, p, bytes, 0);
+        if ( received < 0 && errno == EINTR ) continue;
+        if ( received == 0 ) throw std::runtime_error("[ERROR] A peer closed its connection.");
+        if ( received < 0 ) throw std::runtime_error(std::format("[ERROR] Lost connection to a peer: {}", std::strerror(errno)));
+        p += received;
+        bytes -= static_cast<size_t>(received);
+    }
+}
+
+} // namespace
+
+SocketTransport::SocketTransport(std::string path, const size_t rank, const size_t size,
+                                 const std::chrono::milliseconds timeout) :
+                _path(std::move(path)),
+                _rank(rank),
+                _size(size)
+{
+    if ( size == 0 || rank >= size ) throw std::invalid_argument("[ERROR] Rank must be below the number of ranks.");
+    const sockaddr_un address = addressOf(_path);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    if ( rank == 0 ) {
+        //-- listen and collect every other rank
+        const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if ( listener < 0 ) throw std::runtime_error("[ERROR] Could not create socket.");
+        ::unlink(_path.c_str());
+        if ( ::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0 ||
+             ::listen(listener, static_cast<int>(size)) != 0 ) {
+            ::close(listener);
+            throw std::runtime_error(std::format("[ERROR] Could not listen on socket: {}", _path));
+        }
+
+        _peers.assign(size - 1, -1);
+        try {
+            for ( size_t joined = 0; joined + 1 < size; ) {
+                const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                pollfd waiting{listener, POLLIN, 0};
+                if ( left.count() <= 0 || ::poll(&waiting, 1, static_cast<int>(left.count())) <= 0 ) {
+                    throw std::runtime_error(std::format("[ERROR] Only {} of {} ranks joined in time.", joined + 1, size));
+                }
+                const int peer = ::accept(listener, nullptr, nullptr);
+                if ( peer < 0 ) continue;
+
+                // a peer that connects but never says hello must not block past the deadline
+                Hello hello{};
+                try {
+                    const auto rest = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                    pollfd greeting{peer, POLLIN, 0};
+                    if ( rest.count() <= 0 || ::poll(&greeting, 1, static_cast<int>(rest.count())) <= 0 ) {
+                        throw std::runtime_error(std::format("[ERROR] Only {} of {} ranks joined in time.", joined + 1, size));
+                    }
+                    receiveAll(peer, &hello, sizeof hello);
+                } catch (...) {
+                    ::close(peer);
+                    throw;
+                }
+                if ( hello.size != size || hello.rank == 0 || hello.rank >= size || _peers[hello.rank - 1] != -1 ) {
+                    ::close(peer);
+                    throw std::runtime_error(std::format("[ERROR] Unexpected rank {} of {} joined.", hello.rank, hello.size));
+                }
+                _peers[hello.rank - 1] = peer;
+                ++joined;
+            }
+        } catch (...) {
+            ::close(listener);
+            ::unlink(_path.c_str());
+            for ( const int peer : _peers ) if ( peer >= 0 ) ::close(peer);
+            throw;
+        }
+
+        // everyone is connected, the name is not needed anymore
+        ::close(listener);
+        ::unlink(_path.c_str());
+        return;
+    }
+
+    //-- connect to rank 0, which may not be listening yet
+    while ( true ) {
+        _root = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if ( _root < 0 ) throw std::runtime_error("[ERROR] Could not create socket.");
+        if ( ::connect(_root, reinterpret_cast<const sockaddr*>(&address), sizeof address) == 0 ) break;
+        ::close(_root);
+        _root = -1;
+        if ( std::chrono::steady_clock::now() >= deadline ) {
+            throw std::runtime_error(std::format("[ERROR] Could not connect to rank 0 at: {}", _path));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const Hello hello{rank, size};
+    try {
+        sendAll(_root, &hello, sizeof hello);
+    } catch (...) {
+        // the destructor does not run for a throwing constructor
+        ::close(_root);
+        _root = -1;
+        throw;
+    }
+}
+
+SocketTransport::~SocketTransport() {
+    for ( const int peer : _peers ) if ( peer >= 0 ) ::close(peer);
+    if ( _root >= 0 ) ::close(_root);
+}
+
+size_t SocketTransport::rank() const { return _rank; }
+
+size_t SocketTransport::size() const { return _size; }
+
+template<typename V>
+void SocketTransport::reduce(const std::span<V> values) {
+    const size_t bytes = values.size_bytes();
+
+    if ( _rank != 0 ) {
+        sendAll(_root, values.data(), bytes);
+        receiveAll(_root, values.data(), bytes);
+        return;
+    }
+
+    // added in rank order, so every run gives the same total
+    _scratch.resize(bytes);
+    const auto* incoming = reinterpret_cast<const V*>(_scratch.data());
+    for ( const int peer : _peers ) {
+        receiveAll(peer, _scratch.data(), bytes);
+        for ( size_t i = 0; i < values.size(); ++i ) values[i] += incoming[i];
+    }
+    for ( const int peer : _peers ) sendAll(peer, values.data(), bytes);
+}
+
+void SocketTransport::allReduce(const std::span<double> values) { reduce(values); }
+
+void SocketTransport::allReduce(const std::span<uint64_t> values) { reduce(values); }
+
+void SocketTransport::broadcast(const std::span<std::byte> data) {
+    if ( _rank != 0 ) {
+        receiveAll(_root, data.data(), data.size());
+        return;
+    }
+    for ( const int peer : _peers ) sendAll(peer, data.data(), data.size());
+}
@@ -0,0 +1,44 @@
+#ifndef SOCKETTRANSPORT_H
+#define SOCKETTRANSPORT_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Transport.h"
+
+/*
+ * Transport between processes on one machine over a unix domain socket.
+ * rank 0 listens on `path` and is connected to every other rank (a star):
+ * a reduction sends every buffer to rank 0, which adds them in rank order and
+ * sends the total back. fine for a handful of processes and k x d sized buffers.
+ */
+class SocketTransport final : public Transport {
+    std::string _path;
+    size_t _rank;
+    size_t _size;
+    std::vector<int> _peers;            // rank 0: socket of rank r + 1
+    int _root = -1;                     // other ranks: socket to rank 0
+    std::vector<char> _scratch;         // rank 0: one incoming buffer
+
+    template<typename V>
+    void reduce(std::span<V> values);
+
+public:
+    // rank 0 waits for size - 1 peers, the others retry connecting, both until `timeout`
+    SocketTransport(std::string path, size_t rank, size_t size,
+                    std::chrono::milliseconds timeout = std::chrono::seconds(30));
+    ~SocketTransport() override;
+
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+
+    [[nodiscard]] size_t rank() const override;
+    [[nodiscard]] size_t size() const override;
+
+    void allReduce(std::span<double> values) override;
+    void allReduce(std::span<uint64_t> values) override;
+    void broadcast(std::span<std::byte> data) override;
+};
+
+#endif // SOCKETTRANSPORT_H
@@ -0,0 +1,101 @@
+#include "Sweep.h"
+
+#include <algorithm>
+#include <format>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include "Kmeans.h"
+
+const Sweep::Run& Sweep::Result::bestRun(const int k) const {
+    for ( const size_t index : best ) {
+        if ( runs[index].k == k ) return runs[index];
+    }
+    throw std::invalid_argument(std::format("[ERROR] k = {} was not part of the sweep.", k));
+}
+
+const std::vector<int>& Sweep::Result::bestLabels(const int k) const {
+    for ( size_t i = 0; i < best.size(); ++i ) {
+        if ( runs[best[i]].k == k ) return labels[i];
+    }
+    throw std::invalid_argument(std::format("[ERROR] k = {} was not part of the sweep.", k));
+}
+
+std::vector<std::pair<int, double>> Sweep::Result::curve() const {
+    std::vector<std::pair<int, double>> points;
+    points.reserve(best.size());
+    for ( const size_t index : best ) points.emplace_back(runs[index].k, runs[index].inertia);
+    return points;
+}
+
+template<typename T>
+Sweep::Result Sweep::run(const BasicDataset<T> &points, ThreadPool &pool, const std::span<const int> ks,
+                         const int restarts, const int max_iterations, KmeansConfig config) {
+    if ( ks.empty() || restarts <= 0 ) throw std::invalid_argument("[ERROR] A sweep needs at least one k and one restart.");
+    for ( const int k : ks ) {
+        if ( k <= 0 || static_cast<size_t>(k) > points.rows() ) {
+            throw std::invalid_argument(std::format("[ERROR] k = {} does not fit {} points.", k, points.rows()));
+        }
+    }
+
+    config.numa = false;
+    config.verbose = false;
+
+    const size_t per_k = restarts;
+    const size_t total = ks.size() * per_k;
+
+    Result result;
+    result.runs.resize(total);
+    result.best.assign(ks.size(), total);
+    result.labels.resize(ks.size());
+
+    std::random_device rd;
+    for ( size_t i = 0; i < ks.size(); ++i ) {
+        for ( size_t r = 0; r < per_k; ++r ) {
+            Run& run = result.runs[i * per_k + r];
+            run.k = ks[i];
+            run.restart = static_cast<int>(r);
+            run.seed = config.seed ? *config.seed + static_cast<unsigned>(r) : rd();
+        }
+    }
+
+    // the longest runs first, so the last ones to finish are short
+    std::vector<size_t> order(total);
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::ranges::stable_sort(order, [&result](const size_t a, const size_t b) { return result.runs[a].k > result.runs[b].k; });
+
+    std::mutex best_mutex;
+    pool.parallelFor(0, total, 1, [&](const size_t first, const size_t last) {
+        for ( size_t slot = first; slot < last; ++slot ) {
+            const size_t index = order[slot];
+            Run& run = result.runs[index];
+
+            KmeansConfig run_config = config;
+            run_config.seed = run.seed;
+            BasicDataset<T> view = points.share();
+            BasicKmeans<T> model(run.k, static_cast<int>(points.dimensions()), max_iterations, run_config);
+            model.fit(view, pool);
+
+            run.inertia = model.inertia(view, pool);
+            run.iterations = model.iterations();
+            run.centers = model.centers();
+
+            // keep the labels only while they belong to the best restart of their k
+            const size_t k_index = index / per_k;
+            std::lock_guard<std::mutex> lock(best_mutex);
+            const size_t current = result.best[k_index];
+            if ( current == total || run.inertia < result.runs[current].inertia ||
+                 ( run.inertia == result.runs[current].inertia && run.restart < result.runs[current].restart ) ) {
+                result.best[k_index] = index;
+                result.labels[k_index].assign(view.labels().begin(), view.labels().end());
+            }
+        }
+    });
+
+    return result;
+}
+
+template Sweep::Result Sweep::run(const BasicDataset<float>&, ThreadPool&, std::span<const int>, int, int, KmeansConfig);
+template Sweep::Result Sweep::run(const BasicDataset<double>&, ThreadPool&, std::span<const int>, int, int, KmeansConfig);
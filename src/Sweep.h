@@ -0,0 +1,55 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "Dataset.h"
+#include "KmeansConfig.h"
+#include "Point.h"
+#include "ThreadPool.h"
+
+/*
+ * many fits of one dataset: `restarts` runs for every k, all scheduled on the
+ * pool at once. runs share the values read-only and label their own copy of
+ * the labels, so the dataset is never changed. the fits themselves run their
+ * loops on the same pool, idle workers pick up chunks of any run.
+ * memory grows with the number of concurrent runs: every run holds labels,
+ * and Elkan fits rows x k bounds.
+ */
+class Sweep {
+public:
+    struct Run {
+        int k;
+        int restart;
+        unsigned seed;
+        double inertia;                 // sum of squared distances to the closest center
+        size_t iterations;
+        std::vector<Point> centers;
+    };
+
+    struct Result {
+        std::vector<Run> runs;          // in the order of `ks`, then by restart
+        std::vector<size_t> best;       // per k: index in runs of the lowest inertia restart
+        std::vector<std::vector<int>> labels; // per k: labels of that run
+
+        // lowest inertia run of k, throws if k was not swept
+        [[nodiscard]] const Run& bestRun(int k) const;
+        [[nodiscard]] const std::vector<int>& bestLabels(int k) const;
+        // (k, lowest inertia) in the order of `ks`, for picking k with the elbow
+        [[nodiscard]] std::vector<std::pair<int, double>> curve() const;
+    };
+
+    /*
+     * restart r of every k uses seed config.seed + r when a seed is set, so the
+     * curve compares like with like; fresh random seeds otherwise.
+     * numa placement is turned off, the runs share one copy of the values.
+     */
+    template<typename T>
+    [[nodiscard]] static Result run(const BasicDataset<T> &points, ThreadPool &pool, std::span<const int> ks,
+                                    int restarts, int max_iterations, KmeansConfig config = {});
+};
+
+#endif // SWEEP_H
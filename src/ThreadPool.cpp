@@ -1,13 +1,120 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(const size_t numThreads) : stop(false) {
+#include "Topology.h"
+
+namespace {
+
+// pool and worker index of the current thread, nullptr outside any pool
+thread_local void* currentPool = nullptr;
+thread_local size_t currentIndex = 0;
+
+constexpr int64_t INITIAL_CAPACITY = 256;
+// rounds of failed searches before a waiting thread blocks on its latch
+constexpr int SPINS_BEFORE_BLOCK = 64;
+// helper tasks of one parallelFor that live on the caller's stack
+constexpr size_t INLINE_HELPERS = 32;
+
+} // namespace
+
+//-- deque
+
+ThreadPool::WorkDeque::WorkDeque() {
+    rings.push_back(std::make_unique<Ring>(INITIAL_CAPACITY));
+    ring.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+void ThreadPool::WorkDeque::push(Task* task) {
+    const int64_t b = bottom.load(std::memory_order_relaxed);
+    const int64_t t = top.load(std::memory_order_acquire);
+    Ring* r = ring.load(std::memory_order_relaxed);
+
+    if ( b - t > r->capacity - 1 ) {
+        auto grown = std::make_unique<Ring>(r->capacity * 2);
+        for ( int64_t i = t; i < b; ++i ) grown->put(i, r->get(i));
+        r = grown.get();
+        rings.push_back(std::move(grown));
+        ring.store(r, std::memory_order_release);
+    }
+
+    r->put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+ThreadPool::Task* ThreadPool::WorkDeque::pop() {
+    const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Ring* r = ring.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if ( t > b ) {
+        // empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Task* task = r->get(b);
+    if ( t == b ) {
+        // last one, race the thieves for it
+        if ( !top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) ) task = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+ThreadPool::Task* ThreadPool::WorkDeque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom.load(std::memory_order_acquire);
+    if ( t >= b ) return nullptr;
+
+    Task* task = ring.load(std::memory_order_acquire)->get(t);
+    if ( !top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) ) return nullptr;
+    return task;
+}
+
+//-- pool
+
+ThreadPool::ThreadPool(const size_t numThreads, const bool pin) : stop(false) {
+    for (size_t i = 0; i < numThreads; ++i) deques.push_back(std::make_unique<WorkDeque>());
+    for (size_t i = 0; i < numThreads; ++i) mailboxes.push_back(std::make_unique<Mailbox>());
+    cpus.assign(numThreads, -1);
+    nodes.assign(numThreads, 0);
+
+    if ( pin && numThreads > 0 ) {
+        // evenly spaced over the cpus listed node by node, so nodes get a share each
+        const Topology topology = Topology::detect();
+        const std::vector<int> all = topology.cpus();
+        std::vector<size_t> nodeOfCpu;
+        for ( size_t n = 0; n < topology.nodes().size(); ++n ) {
+            nodeOfCpu.insert(nodeOfCpu.end(), topology.nodes()[n].cpus.size(), n);
+        }
+
+        for (size_t i = 0; i < numThreads; ++i) {
+            const size_t slot = numThreads <= all.size() ? i * all.size() / numThreads : i % all.size();
+            cpus[i] = all[slot];
+            nodes[i] = nodeOfCpu[slot];
+        }
+        // dense node numbers, only nodes that got a worker
+        std::vector<size_t> dense(topology.nodes().size(), SIZE_MAX);
+        nodeCount = 0;
+        for (size_t i = 0; i < numThreads; ++i) {
+            if ( dense[nodes[i]] == SIZE_MAX ) dense[nodes[i]] = nodeCount++;
+            nodes[i] = dense[nodes[i]];
+        }
+    }
+
     for (size_t i = 0; i < numThreads; ++i) {
-        workers.emplace_back(&ThreadPool::workerThread, this);
+        workers.emplace_back(&ThreadPool::workerThread, this, i);
     }
 }
 
 ThreadPool::~ThreadPool() {
-    stop = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stop = true;
+    }
     cv.notify_all();
     for (auto &worker : workers) {
         if (worker.joinable())
@@ -16,17 +123,256 @@ ThreadPool::~ThreadPool() {
 }
 
 size_t ThreadPool::numThreads() const { return workers.size(); }
-void ThreadPool::workerThread() {
+
+size_t ThreadPool::workerIndex() const { return currentPool == this ? currentIndex : workers.size(); }
+
+bool ThreadPool::pinned() const { return !cpus.empty() && cpus.front() >= 0; }
+
+size_t ThreadPool::numNodes() const { return nodeCount; }
+
+size_t ThreadPool::nodeOf(const size_t worker) const { return nodes[worker]; }
+
+void ThreadPool::submit(Task* task) { submit(&task, 1); }
+
+void ThreadPool::submit(Task* const* tasks, const size_t count) {
+    // counted before they are visible, so a worker never sleeps on a queued task
+    queued.fetch_add(static_cast<int64_t>(count), std::memory_order_seq_cst);
+
+    if ( currentPool == this ) {
+        for ( size_t i = 0; i < count; ++i ) deques[currentIndex]->push(tasks[i]);
+    } else {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        injection.insert(injection.end(), tasks, tasks + count);
+        injected.store(injection.size(), std::memory_order_release);
+    }
+
+    if ( sleeping.load(std::memory_order_seq_cst) > 0 ) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        if ( count == 1 ) cv.notify_one();
+        else cv.notify_all();
+    }
+}
+
+ThreadPool::Task* ThreadPool::findTask() {
+    Task* task = nullptr;
+    const bool inside = currentPool == this;
+
+    //-- tasks only this worker may run
+    if ( inside && mailboxes[currentIndex]->pending.load(std::memory_order_acquire) > 0 ) {
+        Mailbox& mailbox = *mailboxes[currentIndex];
+        std::lock_guard<std::mutex> lock(mailbox.mutex);
+        if ( !mailbox.tasks.empty() ) {
+            Task* mine = mailbox.tasks.back();
+            mailbox.tasks.pop_back();
+            mailbox.pending.store(mailbox.tasks.size(), std::memory_order_release);
+            return mine;
+        }
+    }
+
+    //-- own deque first, newest task is the one with warm caches
+    if ( inside ) task = deques[currentIndex]->pop();
+
+    //-- then work from outside the pool
+    if ( !task && injected.load(std::memory_order_acquire) > 0 ) {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        if ( !injection.empty() ) {
+            task = injection.front();
+            injection.pop_front();
+            injected.store(injection.size(), std::memory_order_release);
+        }
+    }
+
+    //-- then steal, starting after ourselves so thieves spread out
+    const size_t n = deques.size();
+    const size_t first = inside ? currentIndex + 1 : 0;
+    for ( size_t i = 0; !task && i < n; ++i ) {
+        const size_t victim = (first + i) % n;
+        if ( inside && victim == currentIndex ) continue;
+        task = deques[victim]->steal();
+    }
+
+    if ( task ) queued.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+void ThreadPool::workerThread(const size_t index) {
+    currentPool = this;
+    currentIndex = index;
+    if ( cpus[index] >= 0 ) Topology::pinCurrentThread(cpus[index]);
+    const Mailbox& mailbox = *mailboxes[index];
+
     while (true) {
-        std::function<void()> task;
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            cv.wait(lock, [this] { return stop || !taskQueue.empty(); });
-            if (stop && taskQueue.empty())
-                return;
-            task = std::move(taskQueue.front());
-            taskQueue.pop();
+        if ( Task* task = findTask() ) {
+            task->run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        cv.wait(lock, [this, &mailbox] {
+            return stop || queued.load(std::memory_order_seq_cst) > 0 || mailbox.pending.load(std::memory_order_seq_cst) > 0;
+        });
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+        if (stop && queued.load() <= 0)
+            return;
+    }
+}
+
+void ThreadPool::wait(const Latch& latch) {
+    int idle = 0;
+    while ( !latch.done() ) {
+        if ( Task* task = findTask() ) {
+            task->run(task);
+            idle = 0;
+        } else if ( ++idle < SPINS_BEFORE_BLOCK ) {
+            std::this_thread::yield();
+        } else {
+            // whatever is left is already running somewhere
+            latch.block();
+        }
+    }
+}
+
+//-- parallelFor
+
+struct ThreadPool::ForJob {
+    struct Helper : Task {
+        ForJob* job;
+    };
+
+    size_t begin, end, grain;
+    void (*call)(void*, size_t, size_t);
+    void* fn;
+
+    std::atomic<size_t> next;           // first index not handed out yet
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    Latch helpers;
+
+    ForJob(const size_t b, const size_t e, const size_t g, void (*c)(void*, size_t, size_t), void* f, const size_t h) :
+        begin(b), end(e), grain(g), call(c), fn(f), next(b), helpers(h) {}
+
+    // grabs chunks until none are left
+    void work() {
+        while ( !failed.load(std::memory_order_relaxed) ) {
+            const size_t b = next.fetch_add(grain, std::memory_order_relaxed);
+            if ( b >= end ) return;
+            try {
+                call(fn, b, std::min(b + grain, end));
+            } catch (...) {
+                if ( !failed.exchange(true) ) error = std::current_exception();
+            }
         }
-        task();
     }
+};
+
+void ThreadPool::runFor(const size_t begin, const size_t end, size_t grain,
+                        void (*call)(void*, size_t, size_t), void* fn) {
+    if ( end <= begin ) return;
+    grain = std::max<size_t>(1, grain);
+    const size_t chunks = (end - begin + grain - 1) / grain;
+
+    // one chunk, or nobody to share with: no synchronisation at all
+    const size_t helpers = std::min(chunks - 1, workers.size());
+    if ( helpers == 0 ) {
+        for ( size_t b = begin; b < end; b += grain ) call(fn, b, std::min(b + grain, end));
+        return;
+    }
+
+    ForJob job(begin, end, grain, call, fn, helpers);
+
+    // no heap allocation unless the pool is very wide
+    ForJob::Helper inline_tasks[INLINE_HELPERS];
+    Task* inline_pointers[INLINE_HELPERS];
+    std::vector<ForJob::Helper> heap_tasks;
+    std::vector<Task*> heap_pointers;
+    ForJob::Helper* tasks = inline_tasks;
+    Task** pointers = inline_pointers;
+    if ( helpers > INLINE_HELPERS ) {
+        heap_tasks.resize(helpers);
+        heap_pointers.resize(helpers);
+        tasks = heap_tasks.data();
+        pointers = heap_pointers.data();
+    }
+
+    for ( size_t i = 0; i < helpers; ++i ) {
+        tasks[i].run = [](Task* self) {
+            ForJob* owner = static_cast<ForJob::Helper*>(self)->job;
+            owner->work();
+            owner->helpers.countDown();
+        };
+        tasks[i].job = &job;
+        pointers[i] = &tasks[i];
+    }
+    submit(pointers, helpers);
+
+    job.work();
+    // helpers still queued touch the job when they run, so all of them must finish
+    wait(job.helpers);
+
+    if ( job.error ) std::rethrow_exception(job.error);
+}
+
+//-- forEachWorker
+
+struct ThreadPool::EachJob {
+    struct Post : Task {
+        EachJob* job;
+        size_t worker;
+    };
+
+    void (*call)(void*, size_t);
+    void* fn;
+
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    Latch done;
+
+    EachJob(void (*c)(void*, size_t), void* f, const size_t n) : call(c), fn(f), done(n) {}
+};
+
+void ThreadPool::runEach(void (*call)(void*, size_t), void* fn) {
+    const size_t n = workers.size();
+    if ( n == 0 ) {
+        call(fn, 0);
+        return;
+    }
+
+    EachJob job(call, fn, n);
+    EachJob::Post inline_posts[INLINE_HELPERS];
+    std::vector<EachJob::Post> heap_posts;
+    EachJob::Post* posts = inline_posts;
+    if ( n > INLINE_HELPERS ) {
+        heap_posts.resize(n);
+        posts = heap_posts.data();
+    }
+
+    for ( size_t i = 0; i < n; ++i ) {
+        posts[i].run = [](Task* self) {
+            const auto* post = static_cast<EachJob::Post*>(self);
+            EachJob* owner = post->job;
+            try {
+                owner->call(owner->fn, post->worker);
+            } catch (...) {
+                if ( !owner->failed.exchange(true) ) owner->error = std::current_exception();
+            }
+            owner->done.countDown();
+        };
+        posts[i].job = &job;
+        posts[i].worker = i;
+
+        Mailbox& mailbox = *mailboxes[i];
+        std::lock_guard<std::mutex> lock(mailbox.mutex);
+        mailbox.tasks.push_back(&posts[i]);
+        mailbox.pending.store(mailbox.tasks.size(), std::memory_order_seq_cst);
+    }
+
+    if ( sleeping.load(std::memory_order_seq_cst) > 0 ) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        cv.notify_all();
+    }
+
+    // a worker calling this runs its own post from here
+    wait(job.done);
+    if ( job.error ) std::rethrow_exception(job.error);
 }
@@ -1,36 +1,162 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+/*
+ * work-stealing pool. every worker owns a lock-free deque: it pushes and pops
+ * at the bottom, idle workers steal from the top. tasks submitted from
+ * outside the pool go through one shared queue.
+ * a thread waiting for parallel work runs queued tasks meanwhile, so nested
+ * parallelFor calls from inside a task cannot deadlock.
+ * pinned pools bind every worker to one cpu, spread over the numa nodes
+ * node by node, so worker i and i + 1 share a node whenever possible.
+ */
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t numThreads);
+    explicit ThreadPool(size_t numThreads, bool pin = false);
     ~ThreadPool();
 
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
     size_t numThreads() const;
+    // index of the calling worker in [0, numThreads()), numThreads() for threads outside the pool
+    size_t workerIndex() const;
+
+    bool pinned() const;
+    // numa nodes the workers run on. unpinned pools count as one node
+    size_t numNodes() const;
+    // node of a worker in [0, numNodes()). workers of one node have consecutive indices
+    size_t nodeOf(size_t worker) const;
 
     // Enqueue a task and get a future.
     template<typename F, typename... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<std::invoke_result_t<F, Args...>>;
 
+    /*
+     * fn(chunk_begin, chunk_end) over [begin, end) cut in chunks of `grain`
+     * indices. the calling thread works too and returns when every chunk is done.
+     * the first exception thrown by fn is rethrown here.
+     */
+    template<typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, F&& fn);
+
+    /*
+     * map(chunk_begin, chunk_end) -> T for every chunk, folded with reduce in
+     * chunk order starting from `identity`. the result only depends on the
+     * grain, not on the number of threads.
+     */
+    template<typename T, typename Map, typename Reduce>
+    T parallelReduce(size_t begin, size_t end, size_t grain, T identity, Map&& map, Reduce&& reduce);
+
+    /*
+     * fn(worker) once on every worker, each on its own thread, for work that
+     * must stay where it was placed. these tasks are never stolen. without
+     * workers fn(0) runs on the caller. the first exception is rethrown here.
+     */
+    template<typename F>
+    void forEachWorker(F&& fn);
+
 private:
+    // intrusive task: run is responsible for everything, including freeing the task
+    struct Task {
+        void (*run)(Task*);
+    };
+
+    // counts down to zero, waiters are woken at zero only
+    // lives on the waiter's stack. the last count down notifies under the mutex,
+    // and the destructor takes it once more, so the latch outlives that call
+    class Latch {
+        std::atomic<size_t> count;
+        mutable std::mutex mutex;
+        mutable std::condition_variable opened;
+    public:
+        explicit Latch(const size_t n) : count(n) {}
+        ~Latch() { std::lock_guard<std::mutex> lock(mutex); }
+        void countDown() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if ( count.fetch_sub(1, std::memory_order_acq_rel) == 1 ) opened.notify_all();
+        }
+        bool done() const { return count.load(std::memory_order_acquire) == 0; }
+        void block() const {
+            std::unique_lock<std::mutex> lock(mutex);
+            opened.wait(lock, [this] { return done(); });
+        }
+    };
+
+    // Chase-Lev deque. push and pop by the owner only, steal by anyone
+    class WorkDeque {
+        struct Ring {
+            int64_t capacity;
+            std::unique_ptr<std::atomic<Task*>[]> slots;
+            explicit Ring(const int64_t c) : capacity(c), slots(new std::atomic<Task*>[c]) {}
+            Task* get(const int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(const int64_t i, Task* t) { slots[i & (capacity - 1)].store(t, std::memory_order_relaxed); }
+        };
+
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+        std::atomic<Ring*> ring;
+        std::vector<std::unique_ptr<Ring>> rings;   // outgrown rings stay alive for late thieves
+
+    public:
+        WorkDeque();
+        void push(Task* task);
+        Task* pop();
+        // nullptr when empty or when another thief won the race
+        Task* steal();
+    };
+
+    // tasks for one worker only, see forEachWorker
+    struct Mailbox {
+        std::mutex mutex;
+        std::vector<Task*> tasks;
+        std::atomic<size_t> pending{0};
+    };
+
+    struct ForJob;
+    struct EachJob;
+
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> taskQueue;
-    
-    mutable std::mutex queueMutex;
+    std::vector<std::unique_ptr<WorkDeque>> deques;
+    std::vector<std::unique_ptr<Mailbox>> mailboxes;
+    std::vector<int> cpus;                      // per worker, -1 when not pinned
+    std::vector<size_t> nodes;                  // per worker
+    size_t nodeCount = 1;
+
+    std::mutex injectionMutex;                  // tasks from threads outside the pool
+    std::deque<Task*> injection;
+    std::atomic<size_t> injected{0};
+
+    std::mutex sleepMutex;
     std::condition_variable cv;
+    std::atomic<int64_t> queued{0};             // submitted and not yet taken
+    std::atomic<int> sleeping{0};
     std::atomic<bool> stop;
 
-    void workerThread();
+    void workerThread(size_t index);
+    void submit(Task* task);
+    void submit(Task* const* tasks, size_t count);
+    Task* findTask();
+    // runs other tasks until the latch opens
+    void wait(const Latch& latch);
+    void runFor(size_t begin, size_t end, size_t grain, void (*call)(void*, size_t, size_t), void* fn);
+    void runEach(void (*call)(void*, size_t), void* fn);
 };
 
 template<typename F, typename... Args>
@@ -39,17 +165,54 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
 {
     using return_type = std::invoke_result_t<F, Args...>;
 
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-    );
+    struct PackagedTask : Task {
+        std::packaged_task<return_type()> task;
+    };
+
+    auto* task = new PackagedTask{{[](Task* self) {
+        auto* packaged = static_cast<PackagedTask*>(self);
+        packaged->task();
+        delete packaged;
+    }}, std::packaged_task<return_type()>(
+        [f = std::forward<F>(f), ...args = std::forward<Args>(args)]() mutable {
+            return std::invoke(f, args...);
+        })};
 
-    std::future<return_type> res = task->get_future();
-    {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        taskQueue.push([task]() { (*task)(); });
-    }
-    cv.notify_one();
+    std::future<return_type> res = task->task.get_future();
+    submit(task);
     return res;
 }
 
-#endif // THREADPOOL_H
\ No newline at end of file
+template<typename F>
+void ThreadPool::parallelFor(const size_t begin, const size_t end, const size_t grain, F&& fn) {
+    using Fn = std::remove_reference_t<F>;
+    runFor(begin, end, grain,
+           [](void* f, const size_t b, const size_t e) { (*static_cast<Fn*>(f))(b, e); },
+           const_cast<void*>(static_cast<const void*>(std::addressof(fn))));
+}
+
+template<typename F>
+void ThreadPool::forEachWorker(F&& fn) {
+    using Fn = std::remove_reference_t<F>;
+    runEach([](void* f, const size_t worker) { (*static_cast<Fn*>(f))(worker); },
+            const_cast<void*>(static_cast<const void*>(std::addressof(fn))));
+}
+
+template<typename T, typename Map, typename Reduce>
+T ThreadPool::parallelReduce(const size_t begin, const size_t end, const size_t grain, T identity,
+                             Map&& map, Reduce&& reduce) {
+    if ( end <= begin ) return identity;
+    const size_t step = std::max<size_t>(1, grain);
+    const size_t chunks = (end - begin + step - 1) / step;
+
+    std::vector<std::optional<T>> partial(chunks);
+    parallelFor(begin, end, step, [&](const size_t b, const size_t e) {
+        partial[(b - begin) / step].emplace(map(b, e));
+    });
+
+    T result = std::move(identity);
+    for ( auto& p : partial ) result = reduce(std::move(result), std::move(*p));
+    return result;
+}
+
+#endif // THREADPOOL_H
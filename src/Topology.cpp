@@ -0,0 +1,110 @@
+#include "Topology.h"
+
+#include <algorithm>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <thread>
+
+namespace {
+
+const std::string NODE_ROOT = "/sys/devices/system/node/";
+
+// first line of a sysfs file, empty if it cannot be read
+std::string readLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    if ( in.is_open() ) std::getline(in, line);
+    return line;
+}
+
+// cpus the process may run on, ascending
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if ( ::sched_getaffinity(0, sizeof set, &set) == 0 ) {
+        for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+            if ( CPU_ISSET(cpu, &set) ) cpus.push_back(cpu);
+        }
+    }
+    if ( cpus.empty() ) {
+        const int count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for ( int cpu = 0; cpu < count; ++cpu ) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+} // namespace
+
+Topology Topology::detect() {
+    const std::vector<int> allowed = allowedCpus();
+    Topology topology;
+
+    for ( const int id : parseCpuList(readLine(NODE_ROOT + "online")) ) {
+        Node node{id, {}};
+        for ( const int cpu : parseCpuList(readLine(NODE_ROOT + "node" + std::to_string(id) + "/cpulist")) ) {
+            if ( std::ranges::binary_search(allowed, cpu) ) node.cpus.push_back(cpu);
+        }
+        // memory-only nodes and nodes outside our cpuset have nothing to run on
+        if ( !node.cpus.empty() ) topology._nodes.push_back(std::move(node));
+    }
+
+    if ( topology._nodes.empty() ) topology._nodes.push_back({0, allowed});
+    return topology;
+}
+
+const std::vector<Topology::Node>& Topology::nodes() const { return _nodes; }
+
+size_t Topology::cpuCount() const {
+    size_t count = 0;
+    for ( const auto& node : _nodes ) count += node.cpus.size();
+    return count;
+}
+
+std::vector<int> Topology::cpus() const {
+    std::vector<int> cpus;
+    for ( const auto& node : _nodes ) cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+    return cpus;
+}
+
+std::vector<int> Topology::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t at = 0;
+    while ( at < list.size() ) {
+        size_t end = list.find(',', at);
+        if ( end == std::string::npos ) end = list.size();
+        const std::string item = list.substr(at, end - at);
+        at = end + 1;
+
+        // malformed items are skipped
+        try {
+            const size_t dash = item.find('-');
+            const int first = std::stoi(item.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            for ( int cpu = first; cpu <= last; ++cpu ) cpus.push_back(cpu);
+        } catch ( const std::exception& ) {}
+    }
+    std::ranges::sort(cpus);
+    const auto [first, last] = std::ranges::unique(cpus);
+    cpus.erase(first, last);
+    return cpus;
+}
+
+bool Topology::pinCurrentThread(const int cpu) {
+    if ( cpu < 0 || cpu >= CPU_SETSIZE ) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::sched_setaffinity(0, sizeof set, &set) == 0;
+}
+
+std::shared_ptr<void> Topology::untouched(const size_t bytes) {
+    const size_t length = std::max<size_t>(1, bytes);
+    void* mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ( mapped == MAP_FAILED ) throw std::runtime_error(std::format("[ERROR] Could not allocate {} bytes.", length));
+    return {mapped, [length](void* p) { ::munmap(p, length); }};
+}
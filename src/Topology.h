@@ -0,0 +1,40 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * numa nodes and their cpus, read from /sys/devices/system/node.
+ * only cpus this process may run on are listed. machines without numa
+ * information in sysfs show up as one node holding every allowed cpu.
+ */
+class Topology {
+public:
+    struct Node {
+        int id;
+        std::vector<int> cpus;          // ascending
+    };
+
+    [[nodiscard]] static Topology detect();
+
+    [[nodiscard]] const std::vector<Node>& nodes() const;
+    [[nodiscard]] size_t cpuCount() const;
+    // every cpu, node by node
+    [[nodiscard]] std::vector<int> cpus() const;
+
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+    [[nodiscard]] static std::vector<int> parseCpuList(const std::string& list);
+    // binds the calling thread to one cpu. false if the kernel refused
+    static bool pinCurrentThread(int cpu);
+    // page aligned memory nobody has touched yet. linux puts every page on the
+    // node of the thread that writes it first. freed with the last owner
+    [[nodiscard]] static std::shared_ptr<void> untouched(size_t bytes);
+
+private:
+    std::vector<Node> _nodes;
+};
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,38 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/*
+ * collective operations between the processes of one distributed fit.
+ * every process is a rank in [0, size()); all ranks must make the same calls
+ * in the same order with buffers of the same size. results are identical on
+ * every rank, and sums are added in rank order so they do not depend on timing.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    [[nodiscard]] virtual size_t rank() const = 0;
+    [[nodiscard]] virtual size_t size() const = 0;
+
+    // element-wise sum over all ranks, written back on every rank
+    virtual void allReduce(std::span<double> values) = 0;
+    virtual void allReduce(std::span<uint64_t> values) = 0;
+    // rank 0's bytes copied to every other rank
+    virtual void broadcast(std::span<std::byte> data) = 0;
+};
+
+// one process on its own: every collective is a no-op
+class LocalTransport final : public Transport {
+public:
+    [[nodiscard]] size_t rank() const override { return 0; }
+    [[nodiscard]] size_t size() const override { return 1; }
+    void allReduce(std::span<double>) override {}
+    void allReduce(std::span<uint64_t>) override {}
+    void broadcast(std::span<std::byte>) override {}
+};
+
+#endif // TRANSPORT_H
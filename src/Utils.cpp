@@ -4,59 +4,117 @@
 
 #include "Utils.h"
 
+#include <algorithm>
+#include <charconv>
 #include <cmath>
+#include <cstdint>
+#include <numeric>
 #include <stdexcept>
 #include <sstream>
 #include <fstream>
 #include <format>
-#include <unordered_set>
 #include <unistd.h>
 #include <limits.h>
 
-double Utils::euclideanDistance(const Point &p1, const Point &p2) {
+#include "Distance.h"
 
-    const size_t size = p1.cords().size();
+namespace {
 
-    if ( size != p2.cords().size() ) {
-        throw std::invalid_argument("The sizes of the coordinates do not match.");
+// rows per block of the parallel grouping, smaller inputs are grouped serially
+constexpr size_t MIN_BLOCK_ROWS = 1 << 16;
+// rows rendered into one buffer by the writers
+constexpr size_t OUTPUT_CHUNK_ROWS = 8192;
+
+// positions of the requested fields in the table's text columns
+std::vector<size_t> textColumns(const CsvTable& info, const std::vector<std::string>& fields) {
+    std::vector<size_t> columns;
+    columns.reserve(fields.size());
+    for ( const auto& field : fields ) {
+        const auto it = std::ranges::find(info.textFields(), field);
+        if ( it == info.textFields().end() ) throw std::invalid_argument(std::format("[ERROR] Column was not loaded: {}", field));
+        columns.push_back(static_cast<size_t>(it - info.textFields().begin()));
     }
+    return columns;
+}
 
-    double sum = .0;
+// members [begin, end) of a cluster, with the cluster's header before its first and a blank line after its last row
+void renderRows(std::string& buffer, const ClusterGroups& groups, const size_t cluster, const size_t begin,
+                const size_t end, const CsvTable& info, const std::vector<size_t>& columns) {
+    const auto members = groups.members(cluster);
+    if ( begin == 0 ) buffer += std::format("Cluster {}: \n", cluster);
 
-    for ( size_t i = 0; i < size; ++i) {
-        sum += std::pow( p1.cords().at(i) - p2.cords().at(i), 2 );
+    for ( size_t m = begin; m < end; ++m ) {
+        // name,album,artists
+        for ( const size_t column : columns ) buffer.append(info.text(members[m], column)).append("; ");
+        buffer += '\n';
     }
 
-    return std::sqrt(sum);
+    if ( end == members.size() ) buffer += '\n';
 }
 
-bool Utils::validate(const std::vector<Point> &vec) {
-
-    // ensure vector has elements
-    const size_t size = vec.size();
-    if (size == 0) return false;
+/*
+ * renders chunks [0, count) in parallel, a window of them at a time, and
+ * writes every window in order with one write per chunk. buffers are reused
+ * between windows, so memory stays at a window's worth of output.
+ */
+template<typename Render>
+void writeChunks(std::ostream& out, const size_t count, ThreadPool& pool, Render&& render) {
+    const size_t window = 4 * (pool.numThreads() + 1);
+    std::vector<std::string> buffers(std::min(window, count));
+
+    for ( size_t first = 0; first < count; first += window ) {
+        const size_t last = std::min(count, first + window);
+        pool.parallelFor(first, last, 1, [&](const size_t b, const size_t e) {
+            for ( size_t c = b; c < e; ++c ) {
+                std::string& buffer = buffers[c - first];
+                buffer.clear();
+                render(c, buffer);
+            }
+        });
+        for ( size_t c = first; c < last; ++c ) {
+            out.write(buffers[c - first].data(), static_cast<std::streamsize>(buffers[c - first].size()));
+        }
+    }
+}
 
-    // get expected amount of elements
-    const size_t expected = vec.at(0).cords().size();
-    if ( expected == 0) return false;
+} // namespace
 
-    return validate(vec,expected);
+double Utils::euclideanDistance(const Point &p1, const Point &p2) {
+    return euclideanDistance(std::span<const double>(p1.cords()), std::span<const double>(p2.cords()));
 }
 
-bool Utils::validate(const std::vector<Point> &vec, const size_t expected) {
+double Utils::euclideanDistance(const std::span<const double> p1, const std::span<const double> p2) {
 
-    // ensure vector has elements
-    const size_t size = vec.size();
-    if (size == 0) return false;
+    const size_t size = p1.size();
 
-    // check if every Point has the same amount of dimensions
-    for ( size_t i = 1 ; i < size; ++i) {
-        if ( vec.at(i).cords().size() != expected ) return false;
+    if ( size != p2.size() ) {
+        throw std::invalid_argument("The sizes of the coordinates do not match.");
     }
 
-    return true;
+    // fixed size kernels when the size has them
+    return std::sqrt(Distance::kernels<double>(size).squaredL2(p1.data(), p2.data()));
+}
+
+template<typename T>
+bool Utils::validate(const BasicDataset<T> &data) {
+    return validate(data, data.dimensions());
+}
+
+template<typename T>
+bool Utils::validate(const BasicDataset<T> &data, const size_t expected) {
+
+    // ensure dataset has elements
+    if (data.empty() || expected == 0) return false;
+
+    // rows share one buffer, so only the stride has to match
+    return data.dimensions() == expected;
 }
 
+template bool Utils::validate(const BasicDataset<float> &);
+template bool Utils::validate(const BasicDataset<double> &);
+template bool Utils::validate(const BasicDataset<float> &, size_t);
+template bool Utils::validate(const BasicDataset<double> &, size_t);
+
 std::vector<std::unordered_map<std::string, std::string>> Utils::processCsv(std::string path, int& counter, const int limit) {
     /*
      * first line of file must be a header
@@ -129,81 +187,66 @@ std::vector<std::string> Utils::findNumericFields(std::unordered_map<std::string
     return response;
 }
 
-void Utils::pointsFromMap(std::vector<Point> &vector,
+void Utils::pointsFromMap(Dataset &dataset,
     const std::vector<std::unordered_map<std::string, std::string>> &data,
     const std::vector<std::string> &fields) {
     /*
-     * vector -> vector where Point objects should be created.
+     * dataset -> dataset where the rows should be created.
      * data -> map with all fields.
      * fields -> fields that should be used to create the point.
      * [!!!] make sure every field contains double.
      */
 
-    // Calculate min and max for each field across all data
-    std::unordered_map<std::string, double> min_vals;
-    std::unordered_map<std::string, double> max_vals;
+    const size_t dims = fields.size();
+    dataset = Dataset(data.size(), dims);
+
+    // parse every cell once straight into the dataset
+    for ( size_t i = 0; i < data.size(); ++i ) {
+        const auto& entry = data[i];
+        const auto row = dataset.row(i);
 
-    // Iterate over data to find the min and max values for each field
-    for (auto& entry : data) {
-        for (auto& field : fields) {
+        for ( size_t f = 0; f < dims; ++f ) {
             double val;
 
-            try { val =  std::stod(entry.at(field)); }
+            try { val =  std::stod(entry.at(fields[f])); }
             catch (std::invalid_argument&) { val = 0; }
 
-            // check if min
-            if (!min_vals.contains(field) || val < min_vals[field]) {
-                min_vals[field] = val;
-            }
-
-            // check if max
-            if (!max_vals.contains(field) || val > max_vals[field]) {
-                max_vals[field] = val;
-            }
+            row[f] = val;
         }
     }
 
+    normalize(dataset);
+}
 
-    // iterate over each entry of data
-    for ( auto& entry : data ) {
-
-        std::vector<double> temp;
-
-        // iterate over fields
-        for ( auto& field : fields) {
-            double val;
-
-            try { val =  std::stod(entry.at(field)); }
-            catch (std::invalid_argument&) { val = 0; }
-
-            const double min_val = min_vals[field];
-            const double max_val = max_vals[field];
+Scaler Utils::normalize(Dataset &dataset) {
+    if ( dataset.empty() ) return {};
 
-            // min-max normalization
-            double den = max_val-min_val;
-            if ( den == 0) den+= 1e-6;
-            double normalizedVal = (val - min_val) / (den);
+    const Scaler scaler = Scaler::fit(ColumnStats::compute(dataset), Scaling::MinMax);
+    for ( size_t i = 0; i < dataset.rows(); ++i ) scaler.transform(dataset.row(i));
+    return scaler;
+}
 
-            temp.push_back(normalizedVal);
-        }
+Scaler Utils::normalize(Dataset &dataset, ThreadPool &pool) {
+    if ( dataset.empty() ) return {};
 
-        // add to the vector
-        vector.emplace_back(temp);
-    }
+    // one parallel pass for the statistics, one to scale
+    Scaler scaler = Scaler::fit(dataset, Scaling::MinMax, pool);
+    scaler.transform(dataset, pool);
+    return scaler;
 }
 
-std::vector<int> Utils::findLonelyClusters(const std::vector<Point> &points, const int num_clusters) {
+std::vector<int> Utils::findLonelyClusters(const std::span<const int> labels, const int num_clusters) {
     std::vector<int> response;
-    std::unordered_set<int> seenClusters;  // To track unique cluster IDs
+    std::vector<bool> seenClusters(num_clusters, false);  // To track unique cluster IDs
 
-    // Collect all clusters that exist in the given points
-    for (const auto& point : points) {
-        seenClusters.insert(point.cluster());
+    // Collect all clusters that exist in the given labels
+    for (const int label : labels) {
+        if ( label >= 0 && label < num_clusters ) seenClusters[label] = true;
     }
 
     // Identify missing clusters
     for (int i = 0; i < num_clusters; ++i) {
-        if (!seenClusters.contains(i)) {
+        if (!seenClusters[i]) {
             response.push_back(i);
         }
     }
@@ -211,53 +254,182 @@ std::vector<int> Utils::findLonelyClusters(const std::vector<Point> &points, con
     return response;
 }
 
-std::map<int,std::vector<int>> Utils::groupByClusters(const std::vector<Point> &points) {
+ClusterGroups Utils::groupByClusters(const std::span<const int> labels) {
+    ClusterGroups groups;
 
-    std::map<int,std::vector<int>>  response;
+    int clusters = 0;
+    for ( const int label : labels ) clusters = std::max(clusters, label + 1);
 
-    // iterate over each point
-    for ( int i  = 0; i < static_cast<int> (points.size()) ; ++i ) {
+    //-- sizes, then where every cluster starts
+    groups.offsets.assign(static_cast<size_t>(clusters) + 1, 0);
+    for ( const int label : labels ) {
+        if ( label >= 0 ) ++groups.offsets[label + 1];
+    }
+    std::partial_sum(groups.offsets.begin(), groups.offsets.end(), groups.offsets.begin());
 
-        Point point;
-        point = points[i];
+    groups.rows.resize(groups.offsets.back());
+    std::vector<size_t> next(groups.offsets.begin(), groups.offsets.end() - 1);
+    for ( size_t i = 0; i < labels.size(); ++i ) {
+        if ( labels[i] >= 0 ) groups.rows[next[labels[i]]++] = static_cast<int>(i);
+    }
 
-        // retrieve cluster_id
-        const int cluster_id = point.cluster();
+    return groups;
+}
 
-        if ( response.contains(cluster_id)) {
-            // already has an entry
-            response[cluster_id].push_back(i);
-            continue;
+ClusterGroups Utils::groupByClusters(const std::span<const int> labels, ThreadPool &pool) {
+    const size_t n = labels.size();
+    const size_t blocks = std::min(n / MIN_BLOCK_ROWS, pool.numThreads() + 1);
+    if ( blocks < 2 ) return groupByClusters(labels);
+    const auto block = [n, blocks](const size_t b) { return n * b / blocks; };
+
+    const int clusters = pool.parallelReduce(size_t{0}, n, MIN_BLOCK_ROWS, 0, [labels](const size_t b, const size_t e) {
+        int top = 0;
+        for ( size_t i = b; i < e; ++i ) top = std::max(top, labels[i] + 1);
+        return top;
+    }, [](const int a, const int b) { return std::max(a, b); });
+    const size_t k = static_cast<size_t>(clusters);
+
+    //-- per block sizes, turned into the position of every block's first row in every cluster.
+    //-- blocks keep their order inside a cluster, so rows stay ascending as in the serial sort
+    std::vector<size_t> next(blocks * k, 0);
+    pool.parallelFor(0, blocks, 1, [&](const size_t first, const size_t last) {
+        for ( size_t b = first; b < last; ++b ) {
+            size_t* counts = next.data() + b * k;
+            for ( size_t i = block(b); i < block(b + 1); ++i ) {
+                if ( labels[i] >= 0 ) ++counts[labels[i]];
+            }
+        }
+    });
+
+    ClusterGroups groups;
+    groups.offsets.resize(k + 1);
+    size_t position = 0;
+    for ( size_t c = 0; c < k; ++c ) {
+        groups.offsets[c] = position;
+        for ( size_t b = 0; b < blocks; ++b ) {
+            const size_t count = next[b * k + c];
+            next[b * k + c] = position;
+            position += count;
         }
-
-        // new entry
-        response[cluster_id] = {i};
-
     }
+    groups.offsets[k] = position;
+
+    groups.rows.resize(position);
+    pool.parallelFor(0, blocks, 1, [&](const size_t first, const size_t last) {
+        for ( size_t b = first; b < last; ++b ) {
+            size_t* positions = next.data() + b * k;
+            for ( size_t i = block(b); i < block(b + 1); ++i ) {
+                if ( labels[i] >= 0 ) groups.rows[positions[labels[i]]++] = static_cast<int>(i);
+            }
+        }
+    });
 
-    return response;
+    return groups;
 }
 
-void Utils::toFile(const std::map<int, std::vector<int>> &map,
+void Utils::toFile(const ClusterGroups &groups,
     const std::vector<std::unordered_map<std::string,std::string>>& info,
     std::ostream& out,
     const std::vector<std::string>& fields) {
 
+    std::string buffer;
+    for ( size_t c = 0; c < groups.clusters(); ++c ) {
+        const auto members = groups.members(c);
+        if ( members.empty() ) continue;
 
-    for ( const auto& [cluster_id, points_id] : map ) {
-        out << std::format("Cluster {}: \n",cluster_id);
-
-        for ( const int i : points_id) {
-
+        buffer.clear();
+        buffer += std::format("Cluster {}: \n", c);
+        for ( const int i : members ) {
             const auto& allTrackInfo = info.at(i);
 
             // name,album,artists
-            std::vector<std::string> temp;
-            for ( auto& field : fields) temp.push_back(std::format("{};" ,allTrackInfo.at(field)));
-            Utils::displayVector(out,temp);
-            out.flush();
+            for ( const auto& field : fields ) buffer.append(allTrackInfo.at(field)).append("; ");
+            buffer += '\n';
+        }
+        buffer += '\n';
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    out.flush();
+}
+
+void Utils::toFile(const ClusterGroups &groups,
+    const CsvTable& info,
+    std::ostream& out,
+    const std::vector<std::string>& fields) {
+
+    const auto columns = textColumns(info, fields);
+    std::string buffer;
+    for ( size_t c = 0; c < groups.clusters(); ++c ) {
+        const auto members = groups.members(c);
+        if ( members.empty() ) continue;
+
+        buffer.clear();
+        renderRows(buffer, groups, c, 0, members.size(), info, columns);
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    out.flush();
+}
+
+void Utils::toFile(const ClusterGroups &groups,
+    const CsvTable& info,
+    std::ostream& out,
+    const std::vector<std::string>& fields,
+    ThreadPool &pool) {
+
+    const auto columns = textColumns(info, fields);
+
+    // big clusters are split, so one cluster cannot keep the other workers waiting
+    struct Piece {
+        size_t cluster;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Piece> pieces;
+    for ( size_t c = 0; c < groups.clusters(); ++c ) {
+        const size_t size = groups.members(c).size();
+        for ( size_t begin = 0; begin < size; begin += OUTPUT_CHUNK_ROWS ) {
+            pieces.push_back({c, begin, std::min(size, begin + OUTPUT_CHUNK_ROWS)});
         }
+    }
 
-        out << std::endl;
+    writeChunks(out, pieces.size(), pool, [&](const size_t p, std::string& buffer) {
+        const Piece& piece = pieces[p];
+        renderRows(buffer, groups, piece.cluster, piece.begin, piece.end, info, columns);
+    });
+    out.flush();
+}
+
+void Utils::writeLabels(const std::span<const int> labels, const std::string &path, const LabelFormat format,
+                        ThreadPool &pool) {
+    static_assert(sizeof(int) == sizeof(int32_t), "binary labels are written as int32");
+
+    std::ofstream out(path, std::ios::binary);
+    if ( !out.is_open() ) throw std::runtime_error(std::format("[ERROR] Could not create file: {}", path));
+
+    if ( format == LabelFormat::Binary ) {
+        out.write(reinterpret_cast<const char*>(labels.data()), static_cast<std::streamsize>(labels.size_bytes()));
     }
-}
\ No newline at end of file
+    else {
+        out << "row,cluster\n";
+        const size_t chunks = (labels.size() + OUTPUT_CHUNK_ROWS - 1) / OUTPUT_CHUNK_ROWS;
+        writeChunks(out, chunks, pool, [labels](const size_t chunk, std::string& buffer) {
+            const size_t begin = chunk * OUTPUT_CHUNK_ROWS;
+            const size_t end = std::min(labels.size(), begin + OUTPUT_CHUNK_ROWS);
+
+            // at most 20 digits of row, a comma, 11 of label and a newline per line
+            buffer.resize((end - begin) * 33);
+            char* at = buffer.data();
+            char* const last = buffer.data() + buffer.size();
+            for ( size_t i = begin; i < end; ++i ) {
+                at = std::to_chars(at, last, i).ptr;
+                *at++ = ',';
+                at = std::to_chars(at, last, labels[i]).ptr;
+                *at++ = '\n';
+            }
+            buffer.resize(static_cast<size_t>(at - buffer.data()));
+        });
+    }
+
+    out.close();
+    if ( !out ) throw std::runtime_error(std::format("[ERROR] Could not write file: {}", path));
+}
@@ -5,20 +5,45 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "CsvReader.h"
+#include "Dataset.h"
 #include "Point.h"
+#include "Scaler.h"
+#include <span>
 #include <unordered_map>
-#include <map>
 #include <string>
 #include <iostream>
 
 
+// row indices grouped by cluster in one array: the rows of cluster c are
+// rows[offsets[c]] up to rows[offsets[c + 1]], ascending
+struct ClusterGroups {
+    std::vector<size_t> offsets;    // clusters + 1 entries
+    std::vector<int> rows;
+
+    [[nodiscard]] size_t clusters() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    [[nodiscard]] std::span<const int> members(const size_t cluster) const {
+        return {rows.data() + offsets[cluster], offsets[cluster + 1] - offsets[cluster]};
+    }
+};
+
+// how writeLabels stores one label per row
+enum class LabelFormat {
+    Csv,    // "row,cluster" header, then one line per row
+    Binary, // int32 per row in native byte order, no header
+};
+
 class Utils {
 public:
     [[nodiscard]] static double euclideanDistance( const Point& p1, const Point& p2);
 
-    [[nodiscard]] static bool validate(const std::vector<Point> & vec);
+    [[nodiscard]] static double euclideanDistance( std::span<const double> p1, std::span<const double> p2);
 
-    [[nodiscard]] static bool validate(const std::vector<Point> &vec, size_t expected);
+    template<typename T>
+    [[nodiscard]] static bool validate(const BasicDataset<T> &data);
+
+    template<typename T>
+    [[nodiscard]] static bool validate(const BasicDataset<T> &data, size_t expected);
 
     [[nodiscard]] static std::vector<std::unordered_map<std::string, std::string>> processCsv(std::string path, int &counter, int limit);
 
@@ -26,13 +51,19 @@ public:
 
     static std::vector<std::string> findNumericFields(std::unordered_map<std::string, std::string> const& data);
 
-    static void pointsFromMap(std::vector<Point> & vector,
+    static void pointsFromMap(Dataset & dataset,
         const std::vector<std::unordered_map<std::string, std::string>> & data,
         const std::vector<std::string> & fields);
 
-    static std::vector<int> findLonelyClusters(const std::vector<Point> &points, int num_clusters);
+    // min-max scaling of every column to [0, 1], in place. returns the fitted scaler
+    static Scaler normalize(Dataset & dataset);
+    static Scaler normalize(Dataset & dataset, ThreadPool & pool);
+
+    static std::vector<int> findLonelyClusters(std::span<const int> labels, int num_clusters);
 
-    static std::map<int, std::vector<int>> groupByClusters(const std::vector<Point> &points);
+    // counting sort by label. negative labels (unassigned rows) are left out
+    static ClusterGroups groupByClusters(std::span<const int> labels);
+    static ClusterGroups groupByClusters(std::span<const int> labels, ThreadPool &pool);
 
     template<class T>
     static void displayVector(std::ostream& os,const std::vector<T>& s) {
@@ -50,9 +81,24 @@ public:
         os << std::endl;
     }
 
-    static void toFile(const std::map<int, std::vector<int>> &map, const std::vector<std::unordered_map<std::string, std::string>> &info,
+    /*
+     * writes every non-empty cluster as a "Cluster c:" line followed by the
+     * fields of its rows. rows are rendered into large buffers, per cluster
+     * or in chunks of big clusters, and the stream is not flushed per line.
+     * the pool overload renders chunks in parallel and writes them in order.
+     */
+    static void toFile(const ClusterGroups &groups, const std::vector<std::unordered_map<std::string, std::string>> &info,
+                       std::ostream& out, const std::vector<std::string> &fields);
+
+    static void toFile(const ClusterGroups &groups, const CsvTable &info,
                        std::ostream& out, const std::vector<std::string> &fields);
 
+    static void toFile(const ClusterGroups &groups, const CsvTable &info,
+                       std::ostream& out, const std::vector<std::string> &fields, ThreadPool &pool);
+
+    // the label of every row, in row order, see LabelFormat
+    static void writeLabels(std::span<const int> labels, const std::string &path, LabelFormat format, ThreadPool &pool);
+
     static std::string getExecutablePath();
 };
 
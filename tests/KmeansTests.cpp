@@ -0,0 +1,570 @@
+// tests of the parts that are easy to break without noticing, one case each.
+// every case throws on failure; ctest runs each one in its own process.
+//
+// usage: kmeans_tests [case...]    no case runs all of them
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/Checkpoint.h"
+#include "../src/Distance.h"
+#include "../src/FeatureCache.h"
+#include "../src/GemmAssigner.h"
+#include "../src/Kmeans.h"
+#include "../src/Scaler.h"
+#include "../src/SocketTransport.h"
+#include "../src/ThreadPool.h"
+#include "../bench/Blobs.h"
+
+namespace {
+
+void check(const bool condition, const std::string_view what) {
+    if ( !condition ) throw std::runtime_error(std::format("[FAIL] {}", what));
+}
+
+// fresh path in the temp directory, removed again when the case ends
+class TempPath {
+    std::filesystem::path _path;
+public:
+    explicit TempPath(const std::string_view name) :
+        _path(std::filesystem::temp_directory_path() / std::format("kmeans_tests_{}_{}", ::getpid(), name)) {
+        std::filesystem::remove(_path);
+    }
+    ~TempPath() {
+        std::error_code ignored;
+        std::filesystem::remove(_path, ignored);
+        std::filesystem::remove(_path.string() + ".tmp", ignored);
+    }
+    [[nodiscard]] std::string str() const { return _path.string(); }
+};
+
+// cuts the last `bytes` off a file
+void truncate(const std::string& path, const uintmax_t bytes) {
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - bytes);
+}
+
+template<typename F>
+bool throws(F&& fn) {
+    try {
+        fn();
+    } catch ( const std::runtime_error& ) {
+        return true;
+    }
+    return false;
+}
+
+Dataset blobs(const size_t rows) {
+    return Blobs{.rows = rows, .dimensions = 4, .k = 8, .seed = 7}.generate();
+}
+
+//-- thread pool
+
+void poolContention() {
+    /*
+     * nested loops push onto the workers' own deques while the idle ones
+     * steal, and outside threads inject loops of their own at the same
+     * time. every index must run exactly once.
+     */
+    ThreadPool pool(4);
+    constexpr size_t OUTER = 64, INNER = 512, CALLERS = 3, ROUNDS = 20;
+    std::vector<std::atomic<int>> hits(CALLERS * OUTER * INNER);
+
+    std::vector<std::thread> callers;
+    for ( size_t t = 0; t < CALLERS; ++t ) {
+        callers.emplace_back([&pool, &hits, t] {
+            for ( size_t round = 0; round < ROUNDS; ++round ) {
+                pool.parallelFor(0, OUTER, 1, [&](const size_t begin, const size_t end) {
+                    for ( size_t o = begin; o < end; ++o ) {
+                        pool.parallelFor(0, INNER, 1, [&](const size_t b, const size_t e) {
+                            for ( size_t i = b; i < e; ++i ) hits[(t * OUTER + o) * INNER + i]++;
+                        });
+                    }
+                });
+            }
+        });
+    }
+    for ( auto& caller : callers ) caller.join();
+    check(std::ranges::all_of(hits, [](const auto& h) { return h.load() == ROUNDS; }), "every index ran once per round");
+
+    // ordered fold and per worker tasks on the same pool afterwards
+    const size_t sum = pool.parallelReduce(size_t{0}, size_t{100000}, 7, size_t{0},
+        [](const size_t begin, const size_t end) {
+            size_t s = 0;
+            for ( size_t i = begin; i < end; ++i ) s += i;
+            return s;
+        }, std::plus<>());
+    check(sum == size_t{100000} * 99999 / 2, "parallelReduce sums every index");
+
+    std::vector<std::atomic<int>> workers(pool.numThreads());
+    pool.forEachWorker([&workers](const size_t worker) { workers[worker]++; });
+    check(std::ranges::all_of(workers, [](const auto& w) { return w.load() == 1; }), "forEachWorker runs once per worker");
+}
+
+//-- distance kernels
+
+template<typename T>
+void kernelsMatchScalar(const size_t dims, const T tolerance) {
+    // 7 centers: one block of four, then three leftovers one at a time
+    constexpr size_t CENTERS = 7, ROWS = 50;
+    std::mt19937 gen(static_cast<unsigned>(dims));
+    std::uniform_real_distribution<T> value(-1, 1);
+    std::vector<T> centers(CENTERS * dims), points(ROWS * dims);
+    for ( auto& v : centers ) v = value(gen);
+    for ( auto& v : points ) v = value(gen);
+
+    const auto score = [&](std::vector<T>& fixed, std::vector<T>& generic) {
+        const auto kernels = Distance::kernels<T>(dims);
+        for ( size_t i = 0; i < ROWS; ++i ) {
+            kernels.squaredL2Block(points.data() + i * dims, centers.data(), CENTERS, fixed.data() + i * CENTERS);
+            Distance::squaredL2Block(points.data() + i * dims, centers.data(), CENTERS, dims, generic.data() + i * CENTERS);
+        }
+    };
+    std::vector<T> expected(ROWS * CENTERS), unused(ROWS * CENTERS);
+    Distance::setIsa(Distance::Isa::Scalar);
+    score(expected, unused);
+
+    for ( const auto isa : {Distance::Isa::SSE2, Distance::Isa::AVX2, Distance::Isa::AVX512} ) {
+        if ( !Distance::supported(isa) ) continue;
+        Distance::setIsa(isa);
+        std::vector<T> fixed(ROWS * CENTERS), generic(ROWS * CENTERS);
+        score(fixed, generic);
+        for ( size_t i = 0; i < expected.size(); ++i ) {
+            const T limit = tolerance * std::max(T{1}, expected[i]);
+            check(std::abs(fixed[i] - expected[i]) <= limit && std::abs(generic[i] - expected[i]) <= limit,
+                  std::format("{} kernel matches the scalar one at d={}", Distance::name(isa), dims));
+        }
+    }
+}
+
+void simdKernels() {
+    const Distance::Isa selected = Distance::isa();
+    // tails of every width for 2, 4, 8 and 16 lanes, and counts with and without their own kernels
+    for ( const size_t dims : {1, 2, 3, 5, 7, 13, 15, 17, 31, 33, 64, 100} ) {
+        kernelsMatchScalar<double>(dims, 1e-12);
+        kernelsMatchScalar<float>(dims, 1e-5f);
+    }
+    Distance::setIsa(selected);
+}
+
+//-- assignment engines
+
+Dataset uniform(const size_t rows, const size_t dimensions, const unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    Dataset points(rows, dimensions);
+    for ( size_t i = 0; i < rows; ++i ) {
+        for ( auto& v : points.row(i) ) v = value(gen);
+    }
+    return points;
+}
+
+void prunedDistanceCounts() {
+    // hamerly rescans cost k + 1 distances, the skipped count must still not wrap
+    ThreadPool pool(2);
+    for ( const auto& [k, dims] : {std::pair<int, size_t>{2, 5}, {3, 13}, {5, 13}, {20, 13}, {64, 13}} ) {
+        for ( const Assignment assignment : {Assignment::Hamerly, Assignment::Elkan} ) {
+            Dataset points = uniform(20000, dims, 5);
+            KmeansConfig config;
+            config.seed = 1;
+            config.verbose = false;
+            config.assignment = assignment;
+            Kmeans model(k, static_cast<int>(dims), 50, config);
+            model.fit(points, pool);
+            const size_t full = points.rows() * static_cast<size_t>(k);
+            check(std::ranges::all_of(model.prunedDistances(), [full](const size_t skipped) { return skipped <= full; }),
+                  std::format("skipped distances of k={} d={} stay below rows * k", k, dims));
+        }
+    }
+}
+
+void prunedLabels() {
+    // the bounds only skip distances that cannot win, so every iteration labels like a full scan
+    ThreadPool pool(2);
+    for ( const auto& [k, dims] : {std::pair<int, size_t>{3, 5}, {12, 13}, {40, 13}} ) {
+        const Dataset points = uniform(8000, dims, 9);
+        std::vector<Checkpoint> fits;
+        for ( const Assignment assignment : {Assignment::Direct, Assignment::Hamerly, Assignment::Elkan} ) {
+            Dataset copy = points;
+            KmeansConfig config;
+            config.seed = 2;
+            config.verbose = false;
+            config.assignment = assignment;
+            Kmeans model(k, static_cast<int>(dims), 100, config);
+            model.fit(copy, pool);
+            fits.push_back(model.checkpoint(copy, pool));
+        }
+        for ( size_t f = 1; f < fits.size(); ++f ) {
+            check(fits[f].labels == fits[0].labels, std::format("pruned labels of k={} d={} match lloyd", k, dims));
+            // same labels, the sums may only be added up in another order
+            check(std::ranges::equal(fits[f].centers, fits[0].centers,
+                                     [](const double a, const double b) { return std::abs(a - b) < 1e-12; }),
+                  std::format("pruned centers of k={} d={} match lloyd", k, dims));
+        }
+    }
+}
+
+template<typename T>
+void gemmMatchesScan(const size_t k, const size_t dims) {
+    /*
+     * rows whose runner-up is further behind than the tie margin must get the
+     * scan's label straight from the product. midpoints of two centers land
+     * inside the margin, predict sends those through the scan again.
+     */
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<T> value(0, 1);
+    std::vector<T> centers(k * dims);
+    for ( auto& v : centers ) v = value(gen);
+
+    const size_t rows = 2000;
+    std::vector<T> points((rows + k - 1) * dims);
+    for ( size_t i = 0; i < rows * dims; ++i ) points[i] = value(gen);
+    for ( size_t c = 0; c + 1 < k; ++c ) {
+        for ( size_t d = 0; d < dims; ++d ) {
+            points[(rows + c) * dims + d] = (centers[c * dims + d] + centers[(c + 1) * dims + d]) / 2;
+        }
+    }
+    const size_t total = points.size() / dims;
+
+    GemmAssigner<T> gemm(k, dims);
+    gemm.setCenters(centers.data());
+    std::vector<int> labels(total, -1);
+    std::vector<T> gaps(total);
+    gemm.assign(points.data(), total, labels.data(), gaps.data());
+
+    const auto kernels = Distance::kernels<T>(dims);
+    size_t close = 0;
+    for ( size_t i = 0; i < total; ++i ) {
+        const T* x = points.data() + i * dims;
+        if ( !(gaps[i] > gemm.tieMargin(x)) ) {
+            ++close;
+            continue;
+        }
+        check(static_cast<size_t>(labels[i]) == kernels.argmin(x, centers.data(), k),
+              std::format("gemm label of row {} matches the scan at k={} d={}", i, k, dims));
+    }
+    check(close > 0, "midpoints fall inside the tie margin");
+
+    // moving a few centers repacks only those, the labels match a freshly packed assigner
+    for ( size_t c = 0; c < k; c += 5 ) centers[c * dims] += T{0.25};
+    gemm.setCenters(centers.data());
+    GemmAssigner<T> fresh(k, dims);
+    fresh.setCenters(centers.data());
+    std::vector<int> moved(total, -1), expected(total, -1);
+    gemm.assign(points.data(), total, moved.data());
+    fresh.assign(points.data(), total, expected.data());
+    check(moved == expected, std::format("gemm after a partial update matches a fresh one at k={} d={}", k, dims));
+
+    // a fitted gemm model, with the midpoints of its own centers as ties
+    BasicDataset<T> data(rows, dims);
+    std::copy_n(points.begin(), rows * dims, data.values().begin());
+    KmeansConfig config;
+    config.seed = 4;
+    config.verbose = false;
+    config.assignment = Assignment::Gemm;
+    BasicKmeans<T> model(static_cast<int>(k), static_cast<int>(dims), 20, config);
+    ThreadPool pool(2);
+    model.fit(data, pool);
+
+    const auto fitted = model.centers();
+    for ( size_t c = 0; c + 1 < k; ++c ) {
+        for ( size_t d = 0; d < dims; ++d ) {
+            points[(rows + c) * dims + d] = static_cast<T>((fitted[c].cords()[d] + fitted[c + 1].cords()[d]) / 2);
+        }
+    }
+    std::vector<int> batch(total);
+    model.predictBatch(points, batch);
+    for ( size_t i = 0; i < total; ++i ) {
+        check(batch[i] == model.predict(std::span<const T>(points.data() + i * dims, dims)),
+              std::format("batched gemm predict of row {} matches predict at k={} d={}", i, k, dims));
+    }
+}
+
+void gemmLabels() {
+    for ( const auto& [k, dims] : {std::pair<size_t, size_t>{37, 13}, {64, 31}, {130, 64}} ) {
+        gemmMatchesScan<float>(k, dims);
+        gemmMatchesScan<double>(k, dims);
+    }
+}
+
+//-- binary formats
+
+void checkpointRoundTrip() {
+    ThreadPool pool(2);
+    Dataset points = blobs(2000);
+    KmeansConfig config;
+    config.seed = 3;
+    config.verbose = false;
+    Kmeans model(8, 4, 100, config);
+    model.fit(points, pool);
+
+    const TempPath path("checkpoint");
+    const Checkpoint saved = model.checkpoint(points, pool);
+    saved.save(path.str());
+    const Checkpoint loaded = Checkpoint::load(path.str());
+    check(loaded.k == saved.k && loaded.dimensions == saved.dimensions, "checkpoint shape");
+    check(loaded.centers == saved.centers && loaded.counts == saved.counts, "checkpoint centers and counts");
+    check(loaded.labels == saved.labels && loaded.row_hashes == saved.row_hashes, "checkpoint labels and hashes");
+
+    bool rejected = false;
+    Checkpoint narrow = saved;
+    narrow.scalar_bytes = sizeof(float);
+    try {
+        model.resume(points, pool, narrow);
+    } catch ( const std::invalid_argument& ) {
+        rejected = true;
+    }
+    check(rejected, "checkpoint of a float model is rejected by a double model");
+
+    truncate(path.str(), sizeof(uint64_t));
+    check(throws([&] { (void)Checkpoint::load(path.str()); }), "truncated checkpoint is rejected");
+
+    // k * dims * 8 + k * 8 wraps to zero, so an unchecked sum would take the bare header for a whole file
+    Checkpoint::Header header{};
+    std::memcpy(header.magic, Checkpoint::MAGIC, sizeof header.magic);
+    header.version = Checkpoint::VERSION;
+    header.scalar_bytes = sizeof(double);
+    header.k = uint64_t{1} << 61;
+    header.dimensions = 1;
+    {
+        std::ofstream out(path.str(), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    }
+    check(throws([&] { (void)Checkpoint::load(path.str()); }), "checkpoint with a wrapping size is rejected");
+}
+
+void scalerRoundTrip() {
+    ThreadPool pool(2);
+    const Dataset points = blobs(1000);
+    const TempPath path("scaler");
+
+    for ( const Scaling scaling : {Scaling::MinMax, Scaling::ZScore, Scaling::Robust} ) {
+        const Scaler saved = Scaler::fit(points, scaling, pool);
+        saved.save(path.str());
+        const Scaler loaded = Scaler::load(path.str());
+        check(loaded.scaling == saved.scaling, "scaler scaling");
+        check(loaded.center == saved.center && loaded.spread == saved.spread, "scaler parameters");
+    }
+
+    truncate(path.str(), 1);
+    check(throws([&] { (void)Scaler::load(path.str()); }), "truncated scaler is rejected");
+}
+
+void cacheRoundTrip() {
+    ThreadPool pool(2);
+    const TempPath csv("cache.csv");
+    const TempPath cache("cache.bin");
+    {
+        std::ofstream out(csv.str());
+        out << "name,a,b,c\n";
+        for ( int i = 0; i < 300; ++i ) out << "row" << i << ',' << i % 17 << ',' << i * 0.5 << ',' << (i * 7) % 11 << '\n';
+    }
+
+    const auto first = FeatureCache::load(csv.str(), cache.str(), pool, {"name"});
+    const auto second = FeatureCache::load(csv.str(), cache.str(), pool, {"name"});
+    check(first.rebuilt && !second.rebuilt, "second load uses the cache");
+    check(second.table.rows() == 300 && second.table.text(299, "name") == "row299", "cached rows and text");
+    check(std::ranges::equal(first.table.features().values(), second.table.features().values()), "cached features");
+    check(first.scaler.center == second.scaler.center && first.scaler.spread == second.scaler.spread, "cached scaler");
+
+    // a cut off cache is not read, the csv is parsed again
+    truncate(cache.str(), sizeof(double));
+    const auto third = FeatureCache::load(csv.str(), cache.str(), pool, {"name"});
+    check(third.rebuilt, "truncated cache is rebuilt");
+    check(std::ranges::equal(first.table.features().values(), third.table.features().values()), "rebuilt features");
+}
+
+//-- transport
+
+void socketAllReduce() {
+    // rank r contributes r + 1 times the base values, so the sums are known
+    const TempPath socket("socket");
+    const auto rank = [&socket](const size_t r) {
+        SocketTransport transport(socket.str(), r, 2);
+        std::vector<double> values = {1.0 * (r + 1), 2.5 * (r + 1), -4.0 * (r + 1)};
+        std::vector<uint64_t> counts = {r + 1, 10 * (r + 1)};
+        transport.allReduce(values);
+        transport.allReduce(counts);
+        check(values == std::vector<double>{3.0, 7.5, -12.0}, "allReduce of doubles");
+        check(counts == std::vector<uint64_t>{3, 30}, "allReduce of counts");
+
+        std::vector<std::byte> message(4, std::byte{0});
+        if ( r == 0 ) message = {std::byte{1}, std::byte{2}, std::byte{3}, std::byte{4}};
+        transport.broadcast(message);
+        check(message[3] == std::byte{4}, "broadcast from rank 0");
+    };
+
+    const pid_t child = ::fork();
+    check(child >= 0, "fork");
+    if ( child == 0 ) {
+        try {
+            rank(1);
+        } catch ( const std::exception& e ) {
+            std::cerr << "rank 1: " << e.what() << std::endl;
+            ::_exit(1);
+        }
+        ::_exit(0);
+    }
+
+    int status = 0;
+    try {
+        rank(0);
+    } catch ( ... ) {
+        ::waitpid(child, &status, 0);
+        throw;
+    }
+    ::waitpid(child, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "rank 1 finished without errors");
+}
+
+void distributedObserver() {
+    // an observer on rank 0 only must not change which collectives the ranks make
+    const TempPath socket("observer");
+    const Blobs spec{.rows = 4000, .dimensions = 4, .k = 8, .seed = 7};
+    const auto rank = [&socket, &spec](const size_t r) {
+        ThreadPool pool(2);
+        Dataset shard = spec.generate(r * spec.rows / 2, (r + 1) * spec.rows / 2);
+        SocketTransport transport(socket.str(), r, 2);
+        KmeansConfig config;
+        config.seed = 5;
+        config.verbose = false;
+        Kmeans model(8, 4, 50, config);
+        size_t observed = 0;
+        double inertia = 0.0;
+        if ( r == 0 ) {
+            model.observe([&observed, &inertia](const IterationMetrics& metrics) {
+                ++observed;
+                inertia = metrics.inertia;
+            });
+        }
+        model.fit(shard, pool, transport);
+        if ( r == 0 ) check(observed == model.iterations() && inertia > 0.0, "rank 0 observed every iteration");
+    };
+
+    const pid_t child = ::fork();
+    check(child >= 0, "fork");
+    if ( child == 0 ) {
+        try {
+            rank(1);
+        } catch ( const std::exception& e ) {
+            std::cerr << "rank 1: " << e.what() << std::endl;
+            ::_exit(1);
+        }
+        ::_exit(0);
+    }
+
+    int status = 0;
+    try {
+        rank(0);
+    } catch ( ... ) {
+        ::waitpid(child, &status, 0);
+        throw;
+    }
+    ::waitpid(child, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "rank 1 finished without errors");
+}
+
+//-- warm start
+
+void resumeEquivalence() {
+    ThreadPool pool(2);
+    Dataset points = blobs(5000);
+    KmeansConfig config;
+    config.seed = 11;
+    config.verbose = false;
+    Kmeans fitted(8, 4, 300, config);
+    fitted.fit(points, pool);
+    const Checkpoint checkpoint = fitted.checkpoint(points, pool);
+
+    // same rows: nothing to move, the fitted model comes back unchanged
+    Kmeans same(8, 4, 300, config);
+    same.resume(points, pool, checkpoint);
+    const Checkpoint again = same.checkpoint(points, pool);
+    check(again.centers == checkpoint.centers, "resume on the same rows keeps the centers");
+    check(again.labels == checkpoint.labels, "resume on the same rows keeps the labels");
+
+    // a few rows jump to another blob: the result is again a fixed point of lloyd
+    const Dataset other = Blobs{.rows = 50, .dimensions = 4, .k = 8, .seed = 99}.generate();
+    for ( size_t i = 0; i < other.rows(); ++i ) std::ranges::copy(other.row(i), points.row(i * 97).begin());
+    Kmeans moved(8, 4, 300, config);
+    moved.resume(points, pool, checkpoint);
+    const Checkpoint after = moved.checkpoint(points, pool);
+
+    std::vector<double> sums(8 * 4, 0.0);
+    std::vector<size_t> counts(8, 0);
+    for ( size_t i = 0; i < points.rows(); ++i ) {
+        const int label = after.labels[i];
+        check(label == moved.predict(points.row(i)), "every row is labelled with its closest center");
+        for ( size_t d = 0; d < 4; ++d ) sums[label * 4 + d] += points.row(i)[d];
+        counts[label]++;
+    }
+    for ( size_t c = 0; c < 8; ++c ) {
+        if ( counts[c] == 0 ) continue;
+        for ( size_t d = 0; d < 4; ++d ) {
+            const double mean = sums[c * 4 + d] / static_cast<double>(counts[c]);
+            check(std::abs(after.centers[c * 4 + d] - mean) < 1e-9, "every center is the mean of its rows");
+        }
+    }
+}
+
+struct Case {
+    const char* name;
+    void (*run)();
+};
+
+constexpr Case CASES[] = {
+    {"pool_contention", poolContention},
+    {"simd_kernels", simdKernels},
+    {"pruned_distance_counts", prunedDistanceCounts},
+    {"pruned_labels", prunedLabels},
+    {"gemm_labels", gemmLabels},
+    {"checkpoint_round_trip", checkpointRoundTrip},
+    {"scaler_round_trip", scalerRoundTrip},
+    {"cache_round_trip", cacheRoundTrip},
+    {"socket_all_reduce", socketAllReduce},
+    {"distributed_observer", distributedObserver},
+    {"resume_equivalence", resumeEquivalence},
+};
+
+} // namespace
+
+int main(const int argc, char* argv[]) {
+    std::vector<std::string_view> wanted(argv + 1, argv + argc);
+    int failed = 0;
+    for ( const auto& [name, run] : CASES ) {
+        if ( !wanted.empty() && std::ranges::find(wanted, name) == wanted.end() ) continue;
+        try {
+            run();
+            std::cout << "[PASS] " << name << std::endl;
+        } catch ( const std::exception& e ) {
+            std::cout << e.what() << " in " << name << std::endl;
+            ++failed;
+        }
+    }
+    for ( const auto name : wanted ) {
+        if ( std::ranges::none_of(CASES, [name](const Case& c) { return name == c.name; }) ) {
+            std::cout << "[FAIL] unknown case " << name << std::endl;
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}